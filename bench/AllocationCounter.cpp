@@ -0,0 +1,29 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+	std::atomic<long long> allocations = 0;
+}
+
+long long heapAllocationCount() {
+	return allocations;
+}
+
+// operator new[] and the nothrow forms forward to these by default
+void* operator new(std::size_t size) {
+	allocations++;
+	if (void* memory = std::malloc(size == 0 ? 1 : size))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
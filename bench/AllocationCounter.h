@@ -0,0 +1,5 @@
+#pragma once
+
+// Heap allocations made through operator new since the program started. The benchmark replaces the global
+// operator new to count them, so allocations made by the driver's C++ code are counted as well as ours.
+long long heapAllocationCount();
@@ -0,0 +1,103 @@
+#include "HeadlessContext.h"
+
+#include <cstdio>
+
+#include "../main/utils/error.h"
+
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#else
+#include <GLFW/glfw3.h>
+#endif
+
+#if defined(__linux__)
+
+HeadlessContext::HeadlessContext() {
+	// Prefer the surfaceless platform, which doesn't need X11 or a GPU device node
+	auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+	EGLDisplay display = EGL_NO_DISPLAY;
+	if (getPlatformDisplay != nullptr)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || eglInitialize(display, &major, &minor) != EGL_TRUE)
+		throw Error("eglInitialize() failed to initialise a display. Error: 0x%x", eglGetError());
+
+	if (eglBindAPI(EGL_OPENGL_API) != EGL_TRUE)
+		throw Error("eglBindAPI() failed to bind the OpenGL API. Error: 0x%x", eglGetError());
+
+	// Request OpenGL version 4.5, which is what llvmpipe exposes
+	EGLint const contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 5,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT)
+		throw Error("eglCreateContext() failed to create an OpenGL 4.5 context. Error: 0x%x", eglGetError());
+
+	if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) != EGL_TRUE)
+		throw Error("eglMakeCurrent() failed. Error: 0x%x", eglGetError());
+
+	_display = display;
+	_context = context;
+
+	if (!gladLoadGLLoader((GLADloadproc)&eglGetProcAddress))
+		throw Error("gladLoadGLLoader() failed - could not load OpenGL API");
+}
+
+HeadlessContext::~HeadlessContext() {
+	eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(_display, _context);
+	eglTerminate(_display);
+}
+
+GLADloadproc HeadlessContext::getProcAddress() {
+	return (GLADloadproc)&eglGetProcAddress;
+}
+
+#else
+
+HeadlessContext::HeadlessContext() {
+	if (glfwInit() != GLFW_TRUE) {
+		char const* errorMessage = nullptr;
+		int errorCode = glfwGetError(&errorMessage);
+		throw Error("glfwInit() failed to initialise GLFW. Error: %s (%d)", errorMessage, errorCode);
+	}
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	GLFWwindow* window = glfwCreateWindow(1, 1, "Water Rendering Bench", nullptr, nullptr);
+	if (window == NULL) {
+		char const* errorMessage = nullptr;
+		int errorCode = glfwGetError(&errorMessage);
+		throw Error("glfwCreateWindow() failed to create a hidden window. Error: %s (%d)", errorMessage, errorCode);
+	}
+
+	glfwMakeContextCurrent(window);
+	_context = window;
+
+	if (!gladLoadGLLoader((GLADloadproc)&glfwGetProcAddress))
+		throw Error("gladLoadGLLoader() failed - could not load OpenGL API");
+}
+
+HeadlessContext::~HeadlessContext() {
+	glfwDestroyWindow(static_cast<GLFWwindow*>(_context));
+	glfwTerminate();
+}
+
+GLADloadproc HeadlessContext::getProcAddress() {
+	return (GLADloadproc)&glfwGetProcAddress;
+}
+
+#endif
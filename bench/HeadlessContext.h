@@ -0,0 +1,22 @@
+#pragma once
+
+#include "glad/glad.h"
+
+// An OpenGL 4.5 core context without a window or monitor, so the compute pipeline can run
+// on build machines with no display (e.g. Mesa llvmpipe).
+// On Linux an EGL surfaceless context is used, elsewhere a hidden GLFW window.
+class HeadlessContext {
+public:
+	HeadlessContext();
+	~HeadlessContext();
+
+	HeadlessContext(HeadlessContext const&) = delete;
+	HeadlessContext& operator=(HeadlessContext const&) = delete;
+
+	// What glad loaded the API with, for extension functions glad doesn't know about
+	static GLADloadproc getProcAddress();
+
+private:
+	void* _display = nullptr;
+	void* _context = nullptr;
+};
@@ -0,0 +1,1016 @@
+// STD libraries
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <fstream>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <future>
+
+// Local classes / files
+#include "AllocationCounter.h"
+#include "HeadlessContext.h"
+#include "../main/Globals.h" // Includes OceanMesh.h, WaveCascadeSet.h, glm.hpp, glad.h
+#include "../main/utils/error.h"
+#include "../main/utils/GpuProfiler.h"
+#include "../main/waves/CpuOceanEngine.h"
+#include "../main/waves/OceanRenderer.h"
+#include "../main/waves/WaveCascadeBuilder.h"
+#include "../main/waves/HeightReadback.h"
+#include "../main/waves/SpectrumCache.h"
+#include "../main/shaders/ShaderManager.h"
+#include "../main/shaders/ProgramCache.h"
+#include "../main/utils/Skybox.h"
+#include "../main/utils/TexturePool.h"
+
+// Defined here as the benchmark doesn't link main/main.cpp
+struct WaveData waveData;
+
+namespace {
+	struct BenchOptions {
+		int frames = 100;
+		int warmupFrames = 10;
+		std::vector<int> sizes; // Empty means every entry in gridSizes
+		std::string format = "csv";
+		std::string outputFile;
+		FastFourierTransform::Mode fftMode = FastFourierTransform::Mode::Auto;
+		MeshMode meshMode = MeshMode::VertexPulling;
+		bool render = false; // Also draw the ocean every frame, offscreen at kRenderWidth x kRenderHeight
+		bool comparePrecision = false;
+		bool firstFrame = false; // Time the startup up to the first rendered frame, serially and overlapped
+		bool cpu = false;
+		bool validate = false;
+		bool checkAllocations = false; // Fail if the frame loop allocates on the heap once warmed up
+		bool readback = false; // Stream the heights back to the CPU every frame with a HeightReadback
+		std::string spectrumCache; // Also time initialise() missing and hitting a SpectrumCache in this directory
+		std::string shaderCache; // ProgramCache directory for program binaries, none by default
+		double tolerance = 1e-4; // Largest RMS error of a validated field, relative to its largest value
+		int threads = 0; // CpuOceanEngine threads, 0 for every hardware thread
+	};
+
+	// Every sample of one stage at one grid size, in milliseconds
+	struct StageTimings {
+		int size;
+		std::string stage;
+		std::vector<double> samples;
+	};
+
+	// Error of one field of the half precision textures against full precision, over every cascade
+	struct PrecisionError {
+		int size;
+		std::string field;
+		size_t fullBytes, halfBytes;
+		double maxError, maxValue;
+		double fullAssemblerTime, halfAssemblerTime; // Mean GPU time of TextureAssembler, in milliseconds
+	};
+
+	// Error of one field of one cascade on the GPU against the CpuOceanEngine
+	struct ValidationError {
+		int size, frame, cascade;
+		std::string field;
+		double maxError, rmsError, maxValue;
+		bool passed;
+	};
+
+	// Offscreen colour and depth target for --render, the size of a 720p window
+	struct RenderTarget {
+		GLuint framebuffer, color, depth;
+	};
+
+	int const kRenderWidth = 1280;
+	int const kRenderHeight = 720;
+
+	BenchOptions parseArguments(int argc, char** argv);
+	void printUsage();
+
+	template<typename Function>
+	double timeStage(Function&& function);
+
+	// Returns the heap allocations made by the frame loop after its first recorded frame
+	long long benchmarkGridSize(int size, BenchOptions const& options, std::vector<StageTimings>& results);
+	RenderTarget createRenderTarget();
+	void deleteRenderTarget(RenderTarget& target);
+	void renderFrame(WaveCascadeSet const& waves, int size, RenderTarget const& target);
+	// Throws if the heights published by the readback don't match the displacement texture
+	void checkReadback(WaveCascadeSet const& waves, HeightReadback& readback);
+	void benchmarkCpuEngine(int size, BenchOptions const& options, std::vector<StageTimings>& results);
+	// One startup at this size from no shaders to the first rendered frame, torn down again afterwards
+	double measureFirstFrame(int size, BenchOptions const& options, bool parallel);
+	void comparePrecision(int size, BenchOptions const& options, std::vector<PrecisionError>& results);
+	void validate(int size, BenchOptions const& options, std::vector<ValidationError>& results);
+	void writeCsv(std::ostream& out, std::vector<StageTimings> const& results);
+	void writeJson(std::ostream& out, std::vector<StageTimings> const& results);
+	void writeCsv(std::ostream& out, std::vector<PrecisionError> const& results);
+	void writeJson(std::ostream& out, std::vector<PrecisionError> const& results);
+	void writeCsv(std::ostream& out, std::vector<ValidationError> const& results);
+	void writeJson(std::ostream& out, std::vector<ValidationError> const& results);
+
+	// Writes to the output file if one was given, otherwise stdout
+	template<typename Result>
+	void writeResults(BenchOptions const& options, std::vector<Result> const& results);
+}
+
+//////////////////////
+// Benchmark method //
+//////////////////////
+int main(int argc, char** argv) try {
+	BenchOptions options = parseArguments(argc, argv);
+
+	// Validation runs the CPU engine too, so by default it sticks to sizes that are quick enough for every commit
+	if (options.sizes.empty() && options.validate)
+		options.sizes = { 16, 64, 256 };
+	else if (options.sizes.empty())
+		options.sizes.assign(std::begin(gridSizes), std::end(gridSizes));
+
+	HeadlessContext context;
+
+	std::fprintf(stderr, "OPENGL_RENDERER: %s\n", glGetString(GL_RENDERER));
+	std::fprintf(stderr, "OPENGL_VERSION: %s\n", glGetString(GL_VERSION));
+
+	ProgramCache::setDirectory(options.shaderCache);
+
+	if (options.firstFrame) {
+		bool parallelCompile = ProgramCache::enableParallelCompile(HeadlessContext::getProcAddress());
+		std::fprintf(stderr, "Parallel shader compilation: %s\n", parallelCompile ? "yes" : "no");
+
+		// The two startups alternate so driver side caches warm up for both alike
+		std::vector<StageTimings> results;
+		for (int size : options.sizes) {
+			std::fprintf(stderr, "Starting up at %dx%d (%d times)\n", size, size, options.frames);
+
+			StageTimings serial{ size, "first frame (serial)" };
+			StageTimings parallel{ size, "first frame (parallel)" };
+			for (int i = 0; i < options.frames; i++) {
+				serial.samples.push_back(measureFirstFrame(size, options, false));
+				parallel.samples.push_back(measureFirstFrame(size, options, true));
+			}
+
+			results.push_back(serial);
+			results.push_back(parallel);
+		}
+
+		writeResults(options, results);
+
+		// Nothing is shared between the startups, so every one compiles (or loads) the same programs
+		std::fprintf(stderr, "Programs: %d compiled, %d loaded from binaries, %d shared\n",
+			ProgramCache::getCompiledCount(), ProgramCache::getBinaryLoadCount(), ProgramCache::getSharedCount());
+		return 0;
+	}
+
+	if (options.comparePrecision) {
+		std::vector<PrecisionError> errors;
+		for (int size : options.sizes) {
+			std::fprintf(stderr, "Comparing precisions at %dx%d (%d frames)\n", size, size, options.frames);
+			comparePrecision(size, options, errors);
+		}
+
+		writeResults(options, errors);
+		return 0;
+	}
+
+	if (options.validate) {
+		std::vector<ValidationError> errors;
+		for (int size : options.sizes) {
+			std::fprintf(stderr, "Validating %dx%d against the CPU (%d frames)\n", size, size, options.frames);
+			validate(size, options, errors);
+		}
+
+		writeResults(options, errors);
+
+		// A failure exits with an error so the mode can gate commits
+		int failures = (int)std::count_if(errors.begin(), errors.end(), [](ValidationError const& error) { return !error.passed; });
+		if (failures > 0) {
+			std::fprintf(stderr, "%d fields are outside the tolerance of %g\n", failures, options.tolerance);
+			return 1;
+		}
+
+		return 0;
+	}
+
+	std::vector<StageTimings> results;
+	long long allocations = 0;
+	for (int size : options.sizes) {
+		std::fprintf(stderr, "Benchmarking %dx%d (%d frames)%s\n", size, size, options.frames, options.cpu ? " on the CPU" : "");
+		if (options.cpu)
+			benchmarkCpuEngine(size, options, results);
+		else
+			allocations += benchmarkGridSize(size, options, results);
+	}
+
+	writeResults(options, results);
+
+	std::fprintf(stderr, "Programs: %d compiled, %d loaded from binaries, %d shared\n",
+		ProgramCache::getCompiledCount(), ProgramCache::getBinaryLoadCount(), ProgramCache::getSharedCount());
+
+	// Like --validate, a failure exits with an error so the mode can gate commits
+	if (options.checkAllocations) {
+		std::fprintf(stderr, "Heap allocations in the frame loop: %lld\n", allocations);
+		if (allocations > 0)
+			return 1;
+	}
+
+	return 0;
+}
+catch (std::exception const& error) {
+	std::fprintf(stderr, "Thrown Exception (%s):\n", typeid(error).name());
+	std::fprintf(stderr, "%s\n", error.what());
+	return 1;
+}
+
+namespace {
+	BenchOptions parseArguments(int argc, char** argv) {
+		BenchOptions options;
+
+		for (int i = 1; i < argc; i++) {
+			std::string argument = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (argument == "--frames" && hasValue) {
+				options.frames = std::max(1, std::atoi(argv[++i]));
+			}
+			else if (argument == "--warmup" && hasValue) {
+				options.warmupFrames = std::max(0, std::atoi(argv[++i]));
+			}
+			else if (argument == "--sizes" && hasValue) {
+				// Comma separated list, e.g. --sizes 64,256
+				std::string list = argv[++i];
+				size_t start = 0;
+				while (start < list.size()) {
+					size_t end = list.find(',', start);
+					if (end == std::string::npos) end = list.size();
+
+					int size = std::atoi(list.substr(start, end - start).c_str());
+					if (std::find(std::begin(gridSizes), std::end(gridSizes), size) == std::end(gridSizes))
+						throw Error("Unsupported grid size: %d", size);
+
+					options.sizes.push_back(size);
+					start = end + 1;
+				}
+			}
+			else if (argument == "--format" && hasValue) {
+				options.format = argv[++i];
+				if (options.format != "csv" && options.format != "json")
+					throw Error("Unknown output format: %s", options.format.c_str());
+			}
+			else if (argument == "--fft" && hasValue) {
+				std::string mode = argv[++i];
+				if (mode == "auto")
+					options.fftMode = FastFourierTransform::Mode::Auto;
+				else if (mode == "shared")
+					options.fftMode = FastFourierTransform::Mode::SharedMemory;
+				else if (mode == "butterfly")
+					options.fftMode = FastFourierTransform::Mode::Butterfly;
+				else
+					throw Error("Unknown FFT mode: %s", mode.c_str());
+			}
+			else if (argument == "--mesh" && hasValue) {
+				std::string mode = argv[++i];
+				if (mode == "indexed")
+					options.meshMode = MeshMode::Indexed;
+				else if (mode == "pulling")
+					options.meshMode = MeshMode::VertexPulling;
+				else if (mode == "clipmap")
+					options.meshMode = MeshMode::Clipmap;
+				else if (mode == "tessellation")
+					options.meshMode = MeshMode::Tessellation;
+				else if (mode == "tiled")
+					options.meshMode = MeshMode::Tiled;
+				else
+					throw Error("Unknown mesh mode: %s", mode.c_str());
+			}
+			else if (argument == "--precision" && hasValue) {
+				std::string precision = argv[++i];
+				if (precision == "full")
+					waveData.precision = WavePrecision::Full;
+				else if (precision == "half")
+					waveData.precision = WavePrecision::Half;
+				else
+					throw Error("Unknown precision: %s", precision.c_str());
+			}
+			else if (argument == "--render") {
+				options.render = true;
+			}
+			else if (argument == "--no-culling") {
+				OceanMesh::setFrustumCulling(false);
+			}
+			else if (argument == "--first-frame") {
+				options.firstFrame = true;
+			}
+			else if (argument == "--compare-precision") {
+				options.comparePrecision = true;
+			}
+			else if (argument == "--check-allocations") {
+				options.checkAllocations = true;
+			}
+			else if (argument == "--readback") {
+				options.readback = true;
+			}
+			else if (argument == "--spectrum-cache" && hasValue) {
+				options.spectrumCache = argv[++i];
+			}
+			else if (argument == "--shader-cache" && hasValue) {
+				options.shaderCache = argv[++i];
+			}
+			else if (argument == "--validate") {
+				options.validate = true;
+			}
+			else if (argument == "--tolerance" && hasValue) {
+				options.tolerance = std::atof(argv[++i]);
+			}
+			else if (argument == "--seed" && hasValue) {
+				waveData.seed = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if (argument == "--cpu") {
+				options.cpu = true;
+			}
+			else if (argument == "--threads" && hasValue) {
+				options.threads = std::max(0, std::atoi(argv[++i]));
+			}
+			else if (argument == "--output" && hasValue) {
+				options.outputFile = argv[++i];
+			}
+			else {
+				printUsage();
+				throw Error("Unknown argument: %s", argument.c_str());
+			}
+		}
+
+		return options;
+	}
+
+	void printUsage() {
+		std::fprintf(stderr,
+			"Usage: WaterRendering-bench [--frames N] [--warmup N] [--sizes 16,32,...] [--fft auto|shared|butterfly] [--precision full|half] [--seed N]\n"
+			"                            [--mesh indexed|pulling|clipmap|tessellation|tiled] [--render [--no-culling]] [--readback] [--spectrum-cache DIR] [--shader-cache DIR] [--check-allocations] [--first-frame] [--compare-precision] [--cpu [--threads N]] [--validate [--tolerance X]]\n"
+			"                            [--format csv|json] [--output FILE]\n");
+	}
+
+	// Wall clock time of a stage including GPU completion, in milliseconds
+	template<typename Function>
+	double timeStage(Function&& function) {
+		glFinish();
+		auto const start = std::chrono::steady_clock::now();
+
+		function();
+
+		glFinish();
+		auto const end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	long long benchmarkGridSize(int size, BenchOptions const& options, std::vector<StageTimings>& results) {
+		WaveCascadeSet waves;
+
+		GpuProfiler::reset();
+
+		StageTimings initialisation{ size, "initialise" };
+		initialisation.samples.push_back(timeStage([&] { waves = initialise(waveData, size, options.fftMode); }));
+
+		// The same set built a step per frame, as the Grid Size combo does, the slowest step is the hitch a resize costs
+		StageTimings rebuildSteps{ size, "rebuild step" };
+		{
+			WaveCascadeBuilder builder(waveData, size, options.fftMode);
+			bool built = false;
+			while (!built)
+				rebuildSteps.samples.push_back(timeStage([&] { built = builder.step(); }));
+		}
+
+		// A cold start that computes and stores the spectra, then a warm one that maps them. The store is only
+		// started within the timing, its file is written in between as the app would over the next frames.
+		StageTimings cacheMiss{ size, "initialise (cache miss)" };
+		StageTimings cacheHit{ size, "initialise (cache hit)" };
+		if (!options.spectrumCache.empty()) {
+			SpectrumCache::setDirectory(options.spectrumCache);
+			std::filesystem::remove(SpectrumCache::entryPath(SpectrumCache::key(size, waveData.seed, cascadeSpectra(waveData))));
+
+			for (StageTimings* stage : { &cacheMiss, &cacheHit }) {
+				WaveCascadeSet cached;
+				stage->samples.push_back(timeStage([&] { cached = initialise(waveData, size, options.fftMode); }));
+				SpectrumCache::finish();
+			}
+
+			SpectrumCache::setDirectory("");
+		}
+
+		// Vertex cache efficiency of the index buffer against the plain row by row order, measured before createVAO releases it
+		OceanMesh::setCacheOptimisedIndices(false);
+		OceanMesh::initialiseMesh(size, options.meshMode);
+		float rowMajorMissRatio = OceanMesh::getCacheMissRatio();
+		OceanMesh::setCacheOptimisedIndices(true);
+		OceanMesh::initialiseMesh(size, options.meshMode);
+		float stripMissRatio = OceanMesh::getCacheMissRatio();
+
+		// The grid the renderer draws, created and uploaded like main.cpp does
+		StageTimings mesh{ size, "mesh" };
+		mesh.samples.push_back(timeStage([&] {
+			OceanMesh::initialiseMesh(size, options.meshMode);
+			OceanMesh::createVAO();
+			OceanMesh::update(glm::vec3(50.0f, 6.0f, 50.0f)); // main.cpp's starting camera
+		}));
+
+		// Before the first frame, so the FFT's butterfly path hasn't created its buffer yet
+		std::fprintf(stderr, "Texture memory: %.2f MiB per cascade, %.2f MiB shared\n",
+			waves.cascadeBytes(0) / (1024.0 * 1024.0), waves.sharedBytes() / (1024.0 * 1024.0));
+
+		if (rowMajorMissRatio > 0)
+			std::fprintf(stderr, "ACMR (%d vertex FIFO): %.3f row by row, %.3f in strips\n", OceanMesh::kVertexCacheSize, rowMajorMissRatio, stripMissRatio);
+
+		StageTimings frame{ size, "frame" };
+		StageTimings render{ size, "render" };
+		StageTimings readbackCapture{ size, "readback" };
+		HeightReadback readback;
+
+		RenderTarget target{};
+		GLuint primitivesQuery = 0;
+		GLuint64 primitives = 0;
+		if (options.render) {
+			target = createRenderTarget();
+			glGenQueries(1, &primitivesQuery);
+
+			// The first use compiles the shaders, after which they stay loaded for every size
+			static bool shadersLoaded = false;
+			if (!shadersLoaded) {
+				ShaderManager::initialiseShaders();
+				shadersLoaded = true;
+			}
+		}
+
+		// Fixed time step so every run evolves the ocean identically
+		float const timeDelta = 1.0f / 60.0f;
+		float totalTime = 0.0f;
+
+		// Recording the samples mustn't count as the frame allocating
+		frame.samples.reserve(options.frames);
+		render.samples.reserve(options.frames);
+		readbackCapture.samples.reserve(options.frames);
+		long long firstAllocation = 0;
+
+		for (int i = 0; i < options.warmupFrames + options.frames; i++) {
+			bool record = i >= options.warmupFrames;
+
+			// The profiler recreates its stages during the first recorded frame, after which nothing should allocate
+			if (i == options.warmupFrames + 1)
+				firstAllocation = heapAllocationCount();
+
+			// Warmup results are discarded by starting the GPU histograms afresh
+			if (i == options.warmupFrames)
+				GpuProfiler::reset();
+			GpuProfiler::beginFrame();
+
+			// Every cascade is evolved, transformed and assembled together
+			double frameTime = timeStage([&] { waves.calculateWavesAtTime(totalTime, timeDelta); });
+
+			if (record)
+				frame.samples.push_back(frameTime);
+
+			// CPU time only, the point is that the frame doesn't wait for the copy
+			if (options.readback) {
+				auto const start = std::chrono::steady_clock::now();
+				readback.capture(waves);
+				auto const end = std::chrono::steady_clock::now();
+
+				if (record)
+					readbackCapture.samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+			}
+
+			if (options.render) {
+				glBeginQuery(GL_PRIMITIVES_GENERATED, primitivesQuery);
+				double renderTime = timeStage([&] { renderFrame(waves, size, target); });
+				glEndQuery(GL_PRIMITIVES_GENERATED);
+
+				if (record)
+					render.samples.push_back(renderTime);
+			}
+
+			totalTime += timeDelta;
+		}
+
+		long long allocations = options.frames > 1 ? heapAllocationCount() - firstAllocation : 0;
+
+		results.push_back(initialisation);
+		results.push_back(rebuildSteps);
+		if (!options.spectrumCache.empty()) {
+			results.push_back(cacheMiss);
+			results.push_back(cacheHit);
+		}
+		results.push_back(mesh);
+		results.push_back(frame);
+
+		if (options.render) {
+			// Includes the skybox-free ocean only, so it's the triangle count of the mesh mode (after tessellation)
+			glGetQueryObjectui64v(primitivesQuery, GL_QUERY_RESULT, &primitives);
+			std::fprintf(stderr, "Rendered %llu triangles per frame at %dx%d\n", (unsigned long long)primitives, kRenderWidth, kRenderHeight);
+
+			results.push_back(render);
+			glDeleteQueries(1, &primitivesQuery);
+			deleteRenderTarget(target);
+		}
+
+		if (options.readback) {
+			results.push_back(readbackCapture);
+			checkReadback(waves, readback);
+			readback.release();
+		}
+
+		// Per-dispatch GPU time of each stage from the profiler (the most recent kHistorySize frames)
+		GpuProfiler::flush();
+		for (GpuProfiler::Stage const& stage : GpuProfiler::getStages()) {
+			StageTimings gpuStage{ size, "gpu:" + stage.label() };
+			for (float sample : stage.orderedHistory())
+				gpuStage.samples.push_back(sample);
+
+			if (!gpuStage.samples.empty())
+				results.push_back(gpuStage);
+		}
+
+		// Release this size's grid before moving on to the next one, its textures go with waves
+		OceanMesh::deleteBuffers();
+
+		return allocations;
+	}
+
+	RenderTarget createRenderTarget() {
+		RenderTarget target{};
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &target.color);
+		glTextureStorage2D(target.color, 1, GL_SRGB8_ALPHA8, kRenderWidth, kRenderHeight);
+
+		glCreateRenderbuffers(1, &target.depth);
+		glNamedRenderbufferStorage(target.depth, GL_DEPTH_COMPONENT24, kRenderWidth, kRenderHeight);
+
+		glCreateFramebuffers(1, &target.framebuffer);
+		glNamedFramebufferTexture(target.framebuffer, GL_COLOR_ATTACHMENT0, target.color, 0);
+		glNamedFramebufferRenderbuffer(target.framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+
+		if (glCheckNamedFramebufferStatus(target.framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			throw Error("The render target framebuffer is incomplete");
+
+		return target;
+	}
+
+	void deleteRenderTarget(RenderTarget& target) {
+		glDeleteFramebuffers(1, &target.framebuffer);
+		glDeleteRenderbuffers(1, &target.depth);
+		glDeleteTextures(1, &target.color);
+		target = RenderTarget{};
+	}
+
+	double measureFirstFrame(int size, BenchOptions const& options, bool parallel) {
+		RenderTarget target = createRenderTarget();
+
+		std::vector<std::string> const faces = {
+			"../assets/skybox/right.bmp",
+			"../assets/skybox/left.bmp",
+			"../assets/skybox/top.bmp",
+			"../assets/skybox/bottom.bmp",
+			"../assets/skybox/front.bmp",
+			"../assets/skybox/back.bmp"
+		};
+
+		// The set and skybox are scoped so everything is back in the pool before clearing it
+		double time = 0.0;
+		{
+		WaveCascadeSet waves;
+		std::unique_ptr<Skybox> skybox;
+
+		time = timeStage([&] {
+			if (parallel) {
+				// As main.cpp starts up: decoding and grid generation on worker threads, every program submitted before any is waited for
+				std::future<std::vector<Skybox::Face>> skyboxFaces = std::async(std::launch::async, Skybox::loadFaces, faces);
+				std::future<void> meshGeneration = std::async(std::launch::async, [&] { OceanMesh::initialiseMesh(size, options.meshMode); });
+
+				ProgramCache::beginBatch();
+				ShaderManager::initialiseShaders();
+				waves = WaveCascadeSet(size, FastFourierTransform(size, options.fftMode), waveData.precision);
+
+				meshGeneration.get();
+				OceanMesh::createVAO();
+
+				skybox = std::make_unique<Skybox>(skyboxFaces.get());
+				ProgramCache::endBatch();
+
+				waves.init(waveData);
+			}
+			else {
+				// Each step waits for the last, every program is checked as soon as it's linked
+				ShaderManager::initialiseShaders();
+				skybox = std::make_unique<Skybox>(faces);
+				waves = initialise(waveData, size, options.fftMode);
+				OceanMesh::initialiseMesh(size, options.meshMode);
+				OceanMesh::createVAO();
+			}
+
+			OceanMesh::update(glm::vec3(50.0f, 6.0f, 50.0f));
+			waves.calculateWavesAtTime(0.0f, 1.0f / 60.0f);
+			renderFrame(waves, size, target);
+		});
+
+		skybox->deleteBuffers();
+		}
+
+		// Every program is released, so the next startup compiles (or loads) them again rather than sharing these
+		OceanMesh::deleteBuffers();
+		ShaderManager::deleteShaders();
+		deleteRenderTarget(target);
+		TexturePool::clear();
+
+		return time;
+	}
+
+	// The ocean as main.cpp draws it from its starting camera, without the skybox and UI
+	void renderFrame(WaveCascadeSet const& waves, int size, RenderTarget const& target) {
+		Camera camera(glm::vec3(50.0f, 6.0f, 50.0f), glm::vec3(1.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+		OceanView view{};
+		view.view = camera.getViewMatrix();
+		view.projection = glm::perspective(glm::radians(120.0f), (float)kRenderWidth / kRenderHeight, 0.1f, 1000.f);
+		view.cameraPosition = camera._position;
+		view.viewportSize = glm::vec2(kRenderWidth, kRenderHeight);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+		glViewport(0, 0, kRenderWidth, kRenderHeight);
+		glEnable(GL_FRAMEBUFFER_SRGB);
+		glEnable(GL_CULL_FACE);
+		glEnable(GL_DEPTH_TEST);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		renderOcean(waves, size, view, OceanMaterial());
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void checkReadback(WaveCascadeSet const& waves, HeightReadback& readback) {
+		int size = waves.size();
+		int cascades = waves.cascadeCount();
+
+		// The last frame's copy has finished after this, so the next capture publishes the texture as it is now
+		glFinish();
+		readback.capture(waves);
+		int latency = readback.getLatency();
+
+		std::vector<float> heights((size_t)size * size * cascades);
+		glGetTextureImage(waves._displacementTexture.id(), 0, GL_GREEN, GL_FLOAT, (GLsizei)(heights.size() * sizeof(float)), heights.data());
+
+		// Bilinear sum of the cascades at points off the texel grid, in double precision
+		double maxError = 0.0;
+		int const points = 1000;
+		for (int i = 0; i < points; i++) {
+			float x = (i * 7.31f) - 3000.0f;
+			float z = (i * 3.17f) - 1000.0f;
+
+			double expected = 0.0;
+			for (int cascade = 0; cascade < cascades; cascade++) {
+				double scale = waves._cascades[cascade]._spectrum.scale;
+				double u = x / scale * size - 0.5;
+				double v = z / scale * size - 0.5;
+				double u0 = std::floor(u), v0 = std::floor(v);
+				double tx = u - u0, tz = v - v0;
+
+				auto texel = [&](double column, double row) {
+					int c = (int)(column - size * std::floor(column / size));
+					int r = (int)(row - size * std::floor(row / size));
+					return (double)heights[((size_t)cascade * size + r) * size + c];
+				};
+
+				expected += (texel(u0, v0) * (1 - tx) + texel(u0 + 1, v0) * tx) * (1 - tz)
+					+ (texel(u0, v0 + 1) * (1 - tx) + texel(u0 + 1, v0 + 1) * tx) * tz;
+			}
+
+			maxError = std::max(maxError, std::abs(readback.sampleHeight(x, z) - expected));
+		}
+
+		std::fprintf(stderr, "Height readback: %d frame(s) latent, max error %g over %d points\n", latency, maxError, points);
+		if (latency != 1 || maxError > 1e-3)
+			throw Error("Height readback doesn't match the displacement texture (latency %d, max error %g)", latency, maxError);
+	}
+
+	// The same ocean on the CpuOceanEngine, timed on the wall clock
+	void benchmarkCpuEngine(int size, BenchOptions const& options, std::vector<StageTimings>& results) {
+		std::unique_ptr<CpuOceanEngine> engine;
+
+		StageTimings initialisation{ size, "cpu:initialise" };
+		initialisation.samples.push_back(timeStage([&] { engine = std::make_unique<CpuOceanEngine>(size, cascadeSpectra(waveData), waveData.seed, options.threads); }));
+
+		std::fprintf(stderr, "CpuOceanEngine threads: %d, FFT: %s\n", engine->threadCount(), engine->usesAvx2() ? "AVX2" : "plain loops");
+
+		StageTimings frame{ size, "cpu:frame" };
+
+		float const timeDelta = 1.0f / 60.0f;
+		float totalTime = 0.0f;
+
+		for (int i = 0; i < options.warmupFrames + options.frames; i++) {
+			double frameTime = timeStage([&] { engine->calculateWavesAtTime(totalTime, timeDelta); });
+
+			if (i >= options.warmupFrames)
+				frame.samples.push_back(frameTime);
+
+			totalTime += timeDelta;
+		}
+
+		results.push_back(initialisation);
+		results.push_back(frame);
+	}
+
+	// A texture array to read back, data is filled in by readTextureArrays
+	struct TextureReadback {
+		GLuint texture;
+		GLenum format;
+		int channels;
+		std::vector<float> data;
+	};
+
+	// Every layer of several texture arrays as floats. All copies go into one pixel pack buffer,
+	// so they are queued together and the CPU only waits once, when the buffer is mapped.
+	void readTextureArrays(std::vector<TextureReadback>& textures, int size, int layers) {
+		size_t texels = (size_t)size * size * layers;
+
+		std::vector<size_t> offsets;
+		size_t bufferSize = 0;
+		for (TextureReadback const& texture : textures) {
+			offsets.push_back(bufferSize);
+			bufferSize += texels * texture.channels * sizeof(float);
+		}
+
+		GLuint buffer;
+		glCreateBuffers(1, &buffer);
+		glNamedBufferStorage(buffer, bufferSize, nullptr, GL_MAP_READ_BIT);
+
+		// The textures were written by image stores
+		glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+		for (size_t i = 0; i < textures.size(); i++) {
+			GLsizei textureSize = (GLsizei)(texels * textures[i].channels * sizeof(float));
+			glGetTextureImage(textures[i].texture, 0, textures[i].format, GL_FLOAT, textureSize, (void*)offsets[i]);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		float const* mapped = (float const*)glMapNamedBufferRange(buffer, 0, bufferSize, GL_MAP_READ_BIT);
+		if (mapped == nullptr)
+			throw Error("Could not map the readback buffer");
+
+		for (size_t i = 0; i < textures.size(); i++) {
+			float const* data = mapped + offsets[i] / sizeof(float);
+			textures[i].data.assign(data, data + texels * textures[i].channels);
+		}
+
+		glUnmapNamedBuffer(buffer);
+		glDeleteBuffers(1, &buffer);
+	}
+
+	// Mean GPU time of a profiler stage, in milliseconds
+	double stageAverage(char const* name) {
+		GpuProfiler::flush();
+		for (GpuProfiler::Stage const& stage : GpuProfiler::getStages()) {
+			if (stage.name == name)
+				return stage.average();
+		}
+
+		return 0.0;
+	}
+
+	// Runs the same ocean with full and half precision textures, both draw the same Gaussian noise from the seed
+	void comparePrecision(int size, BenchOptions const& options, std::vector<PrecisionError>& results) {
+		WaveData fullData = waveData;
+		fullData.precision = WavePrecision::Full;
+
+		WaveCascadeSet full = initialise(fullData, size, options.fftMode);
+		WaveCascadeSet half = WaveCascadeSet(size, FastFourierTransform(size, options.fftMode), WavePrecision::Half);
+		half.init(fullData);
+
+		float const timeDelta = 1.0f / 60.0f;
+		double assemblerTimes[2];
+
+		WaveCascadeSet* sets[2] = { &full, &half };
+		for (int i = 0; i < 2; i++) {
+			GpuProfiler::reset();
+
+			for (int frame = 0; frame < options.frames; frame++) {
+				GpuProfiler::beginFrame();
+				sets[i]->calculateWavesAtTime(frame * timeDelta, timeDelta);
+			}
+
+			assemblerTimes[i] = stageAverage("TextureAssembler");
+		}
+
+		struct Field {
+			char const* name;
+			GLuint fullTexture, halfTexture;
+			GLenum format;
+			int channels;
+			size_t fullTexelBytes, halfTexelBytes;
+		};
+
+		Field fields[] = {
+			{ "displacement", full._displacementTexture.id(), half._displacementTexture.id(), GL_RGBA, 4, 16, 8 },
+			{ "derivatives", full._derivativesTexture.id(), half._derivativesTexture.id(), GL_RGBA, 4, 16, 8 },
+			{ "foam", full._foamTexture.id(), half._foamTexture.id(), GL_RED, 1, 4, 2 }
+		};
+
+		int layers = full.cascadeCount();
+		size_t texels = (size_t)size * size * layers;
+
+		for (Field const& field : fields) {
+			std::vector<TextureReadback> textures = {
+				{ field.fullTexture, field.format, field.channels },
+				{ field.halfTexture, field.format, field.channels }
+			};
+			readTextureArrays(textures, size, layers);
+
+			std::vector<float> const& reference = textures[0].data;
+			std::vector<float> const& reduced = textures[1].data;
+
+			PrecisionError error{ size, field.name, texels * field.fullTexelBytes, texels * field.halfTexelBytes, 0.0, 0.0, assemblerTimes[0], assemblerTimes[1] };
+			for (size_t i = 0; i < reference.size(); i++) {
+				error.maxError = std::max(error.maxError, (double)std::abs(reference[i] - reduced[i]));
+				error.maxValue = std::max(error.maxValue, (double)std::abs(reference[i]));
+			}
+
+			results.push_back(error);
+		}
+
+	}
+
+	// Runs the GPU pipeline and the CpuOceanEngine on the same ocean, comparing every field of every
+	// cascade after the first and the last frame. The textures are full precision so the only
+	// differences are those between the two implementations.
+	void validate(int size, BenchOptions const& options, std::vector<ValidationError>& results) {
+		WaveData fullData = waveData;
+		fullData.precision = WavePrecision::Full;
+
+		WaveCascadeSet waves = initialise(fullData, size, options.fftMode);
+		CpuOceanEngine engine(size, waves.spectra(), fullData.seed, options.threads);
+
+		int cascades = waves.cascadeCount();
+		size_t texels = (size_t)size * size;
+
+		float const timeDelta = 1.0f / 60.0f;
+
+		for (int frame = 0; frame < options.frames; frame++) {
+			waves.calculateWavesAtTime(frame * timeDelta, timeDelta);
+			engine.calculateWavesAtTime(frame * timeDelta, timeDelta);
+
+			if (frame != 0 && frame != options.frames - 1)
+				continue;
+
+			std::vector<TextureReadback> textures = {
+				{ waves._displacementTexture.id(), GL_RGBA, 4 },
+				{ waves._derivativesTexture.id(), GL_RGBA, 4 },
+				{ waves._foamTexture.id(), GL_RED, 1 }
+			};
+			readTextureArrays(textures, size, cascades);
+
+			char const* names[] = { "displacement", "derivatives", "foam" };
+			std::vector<float> const* references[] = { &engine._displacement, &engine._derivatives, &engine._foam };
+
+			for (int field = 0; field < 3; field++) {
+				int channels = textures[field].channels;
+				size_t cascadeValues = texels * channels;
+
+				for (int cascade = 0; cascade < cascades; cascade++) {
+					float const* gpu = textures[field].data.data() + cascade * cascadeValues;
+					float const* cpu = references[field]->data() + cascade * cascadeValues;
+
+					ValidationError error{ size, frame, cascade, names[field], 0.0, 0.0, 0.0, true };
+					double sumSquares = 0.0;
+					for (size_t i = 0; i < cascadeValues; i++) {
+						double difference = std::abs((double)gpu[i] - cpu[i]);
+						error.maxError = std::max(error.maxError, difference);
+						error.maxValue = std::max(error.maxValue, (double)std::abs(cpu[i]));
+						sumSquares += difference * difference;
+					}
+
+					error.rmsError = std::sqrt(sumSquares / cascadeValues);
+					error.passed = error.rmsError <= options.tolerance * std::max(error.maxValue, 1e-6);
+					results.push_back(error);
+				}
+			}
+		}
+	}
+
+	struct Summary {
+		double mean, min, median, max;
+	};
+
+	Summary summarise(std::vector<double> samples) {
+		std::sort(samples.begin(), samples.end());
+		double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+		return { mean, samples.front(), samples[samples.size() / 2], samples.back() };
+	}
+
+	void writeCsv(std::ostream& out, std::vector<StageTimings> const& results) {
+		out << "size,stage,samples,mean_ms,min_ms,median_ms,max_ms\n";
+
+		char line[256];
+		for (StageTimings const& result : results) {
+			Summary summary = summarise(result.samples);
+			std::snprintf(line, sizeof(line), "%d,%s,%zu,%.4f,%.4f,%.4f,%.4f\n",
+				result.size, result.stage.c_str(), result.samples.size(),
+				summary.mean, summary.min, summary.median, summary.max);
+			out << line;
+		}
+	}
+
+	void writeJson(std::ostream& out, std::vector<StageTimings> const& results) {
+		out << "{\n";
+		out << "  \"renderer\": \"" << glGetString(GL_RENDERER) << "\",\n";
+		out << "  \"results\": [\n";
+
+		char line[512];
+		for (size_t i = 0; i < results.size(); i++) {
+			Summary summary = summarise(results[i].samples);
+			std::snprintf(line, sizeof(line),
+				"    { \"size\": %d, \"stage\": \"%s\", \"samples\": %zu, \"mean_ms\": %.4f, \"min_ms\": %.4f, \"median_ms\": %.4f, \"max_ms\": %.4f }%s\n",
+				results[i].size, results[i].stage.c_str(), results[i].samples.size(),
+				summary.mean, summary.min, summary.median, summary.max,
+				i + 1 < results.size() ? "," : "");
+			out << line;
+		}
+
+		out << "  ]\n";
+		out << "}\n";
+	}
+
+	void writeCsv(std::ostream& out, std::vector<PrecisionError> const& results) {
+		out << "size,field,full_bytes,half_bytes,max_error,max_value,full_assembler_ms,half_assembler_ms\n";
+
+		char line[256];
+		for (PrecisionError const& result : results) {
+			std::snprintf(line, sizeof(line), "%d,%s,%zu,%zu,%.6g,%.6g,%.4f,%.4f\n",
+				result.size, result.field.c_str(), result.fullBytes, result.halfBytes,
+				result.maxError, result.maxValue, result.fullAssemblerTime, result.halfAssemblerTime);
+			out << line;
+		}
+	}
+
+	void writeJson(std::ostream& out, std::vector<PrecisionError> const& results) {
+		out << "{\n";
+		out << "  \"renderer\": \"" << glGetString(GL_RENDERER) << "\",\n";
+		out << "  \"precision\": [\n";
+
+		char line[512];
+		for (size_t i = 0; i < results.size(); i++) {
+			std::snprintf(line, sizeof(line),
+				"    { \"size\": %d, \"field\": \"%s\", \"full_bytes\": %zu, \"half_bytes\": %zu, \"max_error\": %.6g, \"max_value\": %.6g, \"full_assembler_ms\": %.4f, \"half_assembler_ms\": %.4f }%s\n",
+				results[i].size, results[i].field.c_str(), results[i].fullBytes, results[i].halfBytes,
+				results[i].maxError, results[i].maxValue, results[i].fullAssemblerTime, results[i].halfAssemblerTime,
+				i + 1 < results.size() ? "," : "");
+			out << line;
+		}
+
+		out << "  ]\n";
+		out << "}\n";
+	}
+
+	void writeCsv(std::ostream& out, std::vector<ValidationError> const& results) {
+		out << "size,frame,cascade,field,max_error,rms_error,max_value,passed\n";
+
+		char line[256];
+		for (ValidationError const& result : results) {
+			std::snprintf(line, sizeof(line), "%d,%d,%d,%s,%.6g,%.6g,%.6g,%d\n",
+				result.size, result.frame, result.cascade, result.field.c_str(),
+				result.maxError, result.rmsError, result.maxValue, result.passed ? 1 : 0);
+			out << line;
+		}
+	}
+
+	void writeJson(std::ostream& out, std::vector<ValidationError> const& results) {
+		out << "{\n";
+		out << "  \"renderer\": \"" << glGetString(GL_RENDERER) << "\",\n";
+		out << "  \"validation\": [\n";
+
+		char line[512];
+		for (size_t i = 0; i < results.size(); i++) {
+			std::snprintf(line, sizeof(line),
+				"    { \"size\": %d, \"frame\": %d, \"cascade\": %d, \"field\": \"%s\", \"max_error\": %.6g, \"rms_error\": %.6g, \"max_value\": %.6g, \"passed\": %s }%s\n",
+				results[i].size, results[i].frame, results[i].cascade, results[i].field.c_str(),
+				results[i].maxError, results[i].rmsError, results[i].maxValue, results[i].passed ? "true" : "false",
+				i + 1 < results.size() ? "," : "");
+			out << line;
+		}
+
+		out << "  ]\n";
+		out << "}\n";
+	}
+
+	template<typename Result>
+	void writeResults(BenchOptions const& options, std::vector<Result> const& results) {
+		if (options.outputFile.empty()) {
+			options.format == "json" ? writeJson(std::cout, results) : writeCsv(std::cout, results);
+			return;
+		}
+
+		std::ofstream file(options.outputFile);
+		if (!file.is_open())
+			throw Error("Could not open output file: %s", options.outputFile.c_str());
+
+		options.format == "json" ? writeJson(file, results) : writeCsv(file, results);
+	}
+}
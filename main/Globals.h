@@ -4,12 +4,14 @@
 
 #include "utils/Camera.h" // Inlcudes glm.hpp
 #include "waves/OceanMesh.h" // Includes Waves.h
-#include "waves/Waves.h"
+#include "waves/WaveCascadeSet.h" // Includes Waves.h
+
+// Selectable ocean grid resolutions, shared by the application and the benchmark
+const int gridSizes[8] = {16, 32, 64, 128, 256, 512, 1024, 2048};
+const char* const gridSizesLabels[] = {"16", "32", "64", "128", "256", "512", "1024", "2048"};
 
 struct GlobalState {
 	Camera camera;
-	Mesh mesh;
-	GLuint meshVAO;
 
 	float timeDelta = 0.f;
 
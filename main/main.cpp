@@ -4,6 +4,10 @@
 #include <numeric>
 #include <iostream>
 #include <chrono>
+#include <cfloat>
+#include <memory>
+#include <future>
+#include <optional>
 
 // 3rd Party Libraries
 #include <glm/gtc/matrix_transform.hpp>
@@ -15,39 +19,50 @@
 
 // Local classes / files
 #include "Globals.h" // Includes OceanMesh.h, Waves.h, glm.hpp, glad.h
+#include "waves/OceanRenderer.h"
+#include "waves/WaveCascadeBuilder.h"
+#include "waves/HeightReadback.h"
+#include "waves/SpectrumCache.h"
 #include <GLFW/glfw3.h>
 #include "shaders/ShaderManager.h"
+#include "shaders/ProgramCache.h"
+#include "shaders/ShaderWatcher.h"
 #include "utils/Skybox.h" // Inclues stb_image.h, error.h
 #include "utils/debug_output.h"
+#include "utils/GpuProfiler.h"
+#include "utils/TexturePool.h"
 
 // Some global variables
 const float PI = 3.14159274f;
 
 bool wireframe = false;
 bool vsync = false;
-const int gridSizes[8] = {16, 32, 64, 128, 256, 512, 1024, 2048};
-const char* gridSizesLabels[] = {"16", "32", "64", "128", "256", "512", "1024", "2048"};
 int gridSize = 4;
+int meshMode = (int)MeshMode::Clipmap;
 struct WaveData waveData;
 
 namespace {
 	std::vector<double> frameTimes;
 	double frameTimeAvg = 0.0;
 	int fpsAvg = 0;
+	double firstFrameTime = 0.0; // From the start of main until the first frame was presented, in milliseconds
 
-	float lightColorPBR[3] = { 300.0f, 300.0f, 300.0f };
-	float lightPosPBR[3] = { 512.0f, 300.0f, 512.0f };
+	OceanMaterial material;
 
-	float albedo[3] = { 0.016f, 0.118f, 0.745f };
-	float metallic = 0.0f;
-	float roughness = 0.1f;
-	float ao = 0.25f;
+	bool showGpuHistograms = true;
 
-	float foamStrength = 1.9f;
-
-	bool recalculate = false;
+	// What renderScene draws, borrowed from the frame loop for the duration of the call
+	struct RenderView {
+		Camera const& camera;
+		WaveCascadeSet const& waves;
+		Skybox const& skybox;
+		float width;
+		float height;
+	};
 
-	void renderScene(GlobalState, float, float, std::array<Waves, 3>, Skybox);
+	void renderScene(RenderView const&);
+	void rebuildMesh(int size);
+	void stageMesh(int size);
 	void processKeys(GLFWwindow*);
 
 	void onCursorPosChange(GLFWwindow* window, double x, double y);
@@ -60,6 +75,7 @@ namespace {
 // Main method //
 /////////////////
 int main() try {
+	auto const launch = std::chrono::steady_clock::now();
 
 	// Try initialise GLFW
 	if (glfwInit() != GLFW_TRUE) {
@@ -133,6 +149,17 @@ int main() try {
 	ImGui_ImplGlfw_InitForOpenGL(_window, true);
 	ImGui_ImplOpenGL3_Init();
 
+	// Destroyed after everything declared below it, so the textures and programs they own are released while
+	// the context still exists. Spectra still being stored, the static OceanMesh and the pool's free textures go last.
+	struct Shutdown {
+		~Shutdown() {
+			SpectrumCache::finish();
+			OceanMesh::deleteBuffers();
+			TexturePool::clear();
+			programShutdown();
+		}
+	} shutdown;
+
 	// Maximise window (not fullscreen)
 	glfwMaximizeWindow(_window);
 	int width, height;
@@ -151,10 +178,11 @@ int main() try {
 	glEnable(GL_DEPTH_TEST);
 	glClearColor(0.2f, 0.2f, 0.2f, 0.0f);
 
-	// Initialise shaders
-	ShaderManager::initialiseShaders();
+	// Programs linked by earlier launches load as binaries instead of compiling
+	ProgramCache::setDirectory("shader_cache");
+	ProgramCache::enableParallelCompile((GLADloadproc)&glfwGetProcAddress);
 
-	// Create skybox
+	// The skybox is decoded and the grid generated on worker threads while the driver compiles
 	std::vector<std::string> faces = {
 		"../assets/skybox/right.bmp",
 		"../assets/skybox/left.bmp",
@@ -163,16 +191,42 @@ int main() try {
 		"../assets/skybox/front.bmp",
 		"../assets/skybox/back.bmp"
 	};
-	Skybox skybox = Skybox(faces);
+	std::future<std::vector<Skybox::Face>> skyboxFaces = std::async(std::launch::async, Skybox::loadFaces, faces);
+	std::future<void> meshGeneration = std::async(std::launch::async, [] { OceanMesh::initialiseMesh(gridSizes[gridSize], (MeshMode)meshMode); });
 
-	// Initialise ocean waves generation (using 3 iterations of different scale)
-	std::array<Waves, 3> waves = initialise(waveData, gridSizes[gridSize]);
+	// Every program is submitted before any is waited for
+	ProgramCache::beginBatch();
+	ShaderManager::initialiseShaders();
 
-	OceanMesh::initialiseMesh(gridSizes[gridSize]);
+	// Ocean waves generation (using 3 iterations of different scale), its spectra are computed once the programs are ready
+	WaveCascadeSet waves = WaveCascadeSet(gridSizes[gridSize], FastFourierTransform(gridSizes[gridSize]), waveData.precision);
+
+	meshGeneration.get();
 	OceanMesh::createVAO();
 
-	globalState.meshVAO = OceanMesh::getMeshVAO();
-	globalState.mesh = OceanMesh::getMesh();
+	Skybox skybox = Skybox(skyboxFaces.get());
+	ProgramCache::endBatch();
+
+	// Sea states seen before load their initial spectra instead of computing them
+	SpectrumCache::setDirectory("spectrum_cache");
+	waves.init(waveData);
+
+	// A grid size being built a step per frame while waves keeps rendering, swapped in once complete
+	std::unique_ptr<WaveCascadeBuilder> pendingWaves;
+
+	// Wave heights for the CPU, a frame or two behind the GPU
+	HeightReadback heightReadback;
+
+	// Saving a shader rebuilds its programs while the old ones keep rendering. Without it (no inotify, or started
+	// from another directory) the app runs as usual, and why is shown in the Shader Errors window.
+	std::optional<ShaderWatcher> shaderWatcher;
+	std::string shaderWatcherError;
+	try {
+		shaderWatcher.emplace("../shaders");
+	}
+	catch (Error const& error) {
+		shaderWatcherError = std::string("Shader hot reload is off: ") + error.what();
+	}
 
 	// Setup viewport
 	int fbwidth, fbheight;
@@ -193,13 +247,33 @@ int main() try {
 		glfwSwapInterval(vsync);
 		glfwPollEvents();
 
+		GpuProfiler::beginFrame();
+
 		// ImGui frame
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
 		ImGui::NewFrame();
 		/**/
 		ImGui::Begin("Debug");
-		ImGui::Combo("Grid Size", &gridSize, gridSizesLabels, 8);
+		if (ImGui::Combo("Grid Size", &gridSize, gridSizesLabels, 8)) {
+			// Only the latest choice is built, anything half built for an earlier one is thrown away
+			pendingWaves.reset();
+			OceanMesh::discardStaged();
+
+			if (gridSizes[gridSize] != waves.size()) {
+				pendingWaves = std::make_unique<WaveCascadeBuilder>(waveData, gridSizes[gridSize]);
+				stageMesh(gridSizes[gridSize]);
+			}
+		}
+		if (pendingWaves) {
+			ImGui::SameLine();
+			ImGui::Text("Building...");
+		}
+		if (ImGui::Combo("Mesh", &meshMode, "Indexed\0Vertex Pulling\0Clipmap\0Tessellation\0Tiled\0")) {
+			rebuildMesh(waves.size());
+			if (pendingWaves)
+				stageMesh(pendingWaves->size());
+		}
 		ImGui::SliderInt("Scale 1", &waveData.scale1, 1, 300);
 		ImGui::SliderInt("Scale 2", &waveData.scale2, 1, 50);
 		ImGui::SliderInt("Scale 3", &waveData.scale3, 1, 50);
@@ -208,15 +282,16 @@ int main() try {
 		ImGui::SliderFloat("Gravity", &waveData.gravity, 0.1f, 20.0f);
 		ImGui::SliderFloat("Fetch", &waveData.fetch, 0.1f, 1000000.0f);
 		ImGui::SliderFloat("Wave Direction", &waveData.angle, 0.0f, 360.0f);
-		ImGui::Checkbox("Recalculate Parameters", &recalculate);
 
 		ImGui::Text("Water Material Properties - PBR");
-		ImGui::DragFloat3("Light Position (PBR)", lightPosPBR);
-		ImGui::ColorEdit3("Albedo", albedo);
-		ImGui::SliderFloat("Metallic", &metallic, 0.0f, 1.0f);
-		ImGui::SliderFloat("Roughness", &roughness, 0.0f, 1.0f);
-		ImGui::SliderFloat("Ambient Occlusion", &ao, 0.0f, 1.0f);
-		ImGui::SliderFloat("Foam Strength", &foamStrength, 1.0f, 4.0f);
+		ImGui::DragFloat3("Light Position (PBR)", &material.lightPosition.x);
+		ImGui::ColorEdit3("Albedo", &material.albedo.x);
+		ImGui::SliderFloat("Metallic", &material.metallic, 0.0f, 1.0f);
+		ImGui::SliderFloat("Roughness", &material.roughness, 0.0f, 1.0f);
+		ImGui::SliderFloat("Ambient Occlusion", &material.ao, 0.0f, 1.0f);
+		ImGui::SliderFloat("Foam Strength", &material.foamStrength, 1.0f, 4.0f);
+		if (OceanMesh::getMeshMode() == MeshMode::Tessellation)
+			ImGui::SliderFloat("Tessellation Edge (px)", &material.tessellationEdge, 1.0f, 64.0f);
 
 		if (ImGui::Button("Reset Values")) {
 			waveData.scale1 = 250;
@@ -228,46 +303,118 @@ int main() try {
 			waveData.fetch = 100000.0f;
 			waveData.angle = 29.81f;
 
-			lightPosPBR[0] = 512.0f;
-			lightPosPBR[1] = 300.0f;
-			lightPosPBR[2] = 512.0f;
-			albedo[0] = 0.016f;
-			albedo[1] = 0.118;
-			albedo[2] = 0.745f;
-			metallic = 0.0f;
-			roughness = 0.1f;
-			ao = 0.25f;
-
-			foamStrength = 1.9f;
+			material = OceanMaterial();
 		}
 
 		ImGui::Checkbox("Wireframe", &wireframe);
 		ImGui::SameLine();
 		ImGui::Checkbox("VSync", &vsync);
+		ImGui::SameLine();
+		bool frustumCulling = OceanMesh::getFrustumCulling();
+		if (ImGui::Checkbox("Frustum Culling", &frustumCulling))
+			OceanMesh::setFrustumCulling(frustumCulling);
 
 		ImGui::End();
 
 		ImGui::Begin("Stats");
 		ImGui::Text("Frame time: %.3fms (Avg: %.3fms)", frameTime * 1000, frameTimeAvg * 1000);
 		ImGui::Text("FPS: %d (Avg: %d)", fps, fpsAvg);
-		ImGui::Text("Vertices: %d", globalState.mesh.positions.size());
-		ImGui::Text("Triangles: %d", globalState.mesh.positions.size() / 3);
+		ImGui::Text("Time to first frame: %.1fms", firstFrameTime);
+		ImGui::Text("Programs reloaded: %d", ProgramCache::getReloadCount());
+		if (OceanMesh::getMeshMode() == MeshMode::Tessellation) {
+			ImGui::Text("Patches: %d", OceanMesh::getPatchCount());
+		}
+		else if (OceanMesh::getMeshMode() == MeshMode::Tiled) {
+			ImGui::Text("Candidate Tiles: %d", OceanMesh::getTiledCandidateCount());
+		}
+		else {
+			ImGui::Text("Vertices: %d", OceanMesh::getVertexCount());
+			ImGui::Text("Triangles: %d", OceanMesh::getTriangleCount());
+		}
+		if (OceanMesh::getMeshMode() == MeshMode::Clipmap)
+			ImGui::Text("Clipmap Tiles: %d", OceanMesh::getTileCount());
 		ImGui::Text("Camera Position: %f %f %f", globalState.camera._position.x, globalState.camera._position.y, globalState.camera._position.z);
+		ImGui::Text("Water Height Below Camera: %.3f (%d frames old)", heightReadback.sampleHeight(globalState.camera._position.x, globalState.camera._position.z), heightReadback.getLatency());
+
+		if (ImGui::CollapsingHeader("GPU Memory")) {
+			float const MiB = 1024.0f * 1024.0f;
+
+			// Both sets are resident while a new grid size is being built
+			ImGui::Text("Textures: %.1f MiB (%.1f MiB free in pool)", TexturePool::getUsedBytes() / MiB, TexturePool::getFreeBytes() / MiB);
+			for (int i = 0; i < waves.cascadeCount(); i++)
+				ImGui::Text("  Cascade %d: %.1f MiB", i, waves.cascadeBytes(i) / MiB);
+			ImGui::Text("  Noise + FFT: %.1f MiB", waves.sharedBytes() / MiB);
+			for (TexturePool::FormatUsage const& format : TexturePool::getUsageByFormat())
+				ImGui::Text("  %-8s %3d textures, %.1f MiB", TexturePool::formatName(format.internalFormat), format.textures, format.bytes / MiB);
+		}
+
+		if (ImGui::CollapsingHeader("GPU Timings", ImGuiTreeNodeFlags_DefaultOpen)) {
+			bool profilerEnabled = GpuProfiler::isEnabled();
+			if (ImGui::Checkbox("Enabled", &profilerEnabled))
+				GpuProfiler::setEnabled(profilerEnabled);
+			ImGui::SameLine();
+			ImGui::Checkbox("Histograms", &showGpuHistograms);
+			ImGui::SameLine();
+			if (ImGui::Button("Dump GPU Timings"))
+				GpuProfiler::dumpToFile("gpu_timings.json");
+
+			float totalGpuTime = 0.0f;
+			for (GpuProfiler::Stage const& stage : GpuProfiler::getStages()) {
+				// Stages that haven't run recently (e.g. WaveSpectra) don't count towards the frame
+				if (stage.lastFrame + GpuProfiler::kFrameLatency >= GpuProfiler::getFrame())
+					totalGpuTime += stage.latest();
+			}
+			ImGui::Text("Total: %.3fms", totalGpuTime);
+
+			for (GpuProfiler::Stage const& stage : GpuProfiler::getStages()) {
+				char label[128];
+				stage.formatLabel(label, sizeof(label));
+				ImGui::Text("%-28s %.3fms (avg %.3fms, p95 %.3fms)", label, stage.latest(), stage.average(), stage.percentile(0.95f));
+
+				if (showGpuHistograms) {
+					int offset = stage.historyCount < GpuProfiler::kHistorySize ? 0 : stage.historyHead;
+					ImGui::PushID(&stage);
+					ImGui::PlotHistogram("##history", stage.history.data(), stage.historyCount, offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 24));
+					ImGui::PopID();
+				}
+			}
+		}
 		ImGui::End();
 
-		if (recalculate) {
-			float boundary1 = 2 * PI / waveData.scale2 * 6.f;
-			float boundary2 = 2 * PI / waveData.scale3 * 6.f;
+		// A shader that failed to reload is shown here until it's fixed, its last good version renders meanwhile
+		if (shaderWatcher) {
+			for (std::string const& fileName : shaderWatcher->takeChanges())
+				ProgramCache::reload(fileName);
+		}
+		ProgramCache::updateReloads();
+
+		if (!ProgramCache::getReloadErrors().empty() || !shaderWatcherError.empty()) {
+			ImGui::Begin("Shader Errors");
+			if (!shaderWatcherError.empty())
+				ImGui::TextUnformatted(shaderWatcherError.c_str());
+			ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.4f, 0.4f, 1.0f));
+			for (auto const& [program, error] : ProgramCache::getReloadErrors())
+				ImGui::TextUnformatted(error.c_str());
+			ImGui::PopStyleColor();
+			ImGui::End();
+		}
+
+		// Only the cascades a slider changed, once per frame however far it was dragged
+		waves.applyWaveData(waveData);
 
-			waves[0].recalculateInitials(waveData, waveData.scale1, 0.0001f, boundary1);
-			waves[1].recalculateInitials(waveData, waveData.scale2, boundary1, boundary2);
-			waves[2].recalculateInitials(waveData, waveData.scale3, boundary2, 9999.9f);
+		// Writes the spectra of new sea states to disk once the GPU has copied them back
+		SpectrumCache::update();
+
+		// The old grid size renders until the new one and its mesh are complete, then both swap within the frame
+		if (pendingWaves && pendingWaves->step() && OceanMesh::uploadStaged()) {
+			waves = std::move(pendingWaves->result());
+			pendingWaves.reset();
+			OceanMesh::swapStaged();
 		}
 
-		// Update waves
-		waves[0].calculateWavesAtTime(totalTime, globalState.timeDelta);
-		waves[1].calculateWavesAtTime(totalTime, globalState.timeDelta);
-		waves[2].calculateWavesAtTime(totalTime, globalState.timeDelta);
+		// Update all cascades of waves at once
+		waves.calculateWavesAtTime(totalTime, globalState.timeDelta);
+		heightReadback.capture(waves);
 
 		// Timings and FPS
 		auto const now = std::chrono::steady_clock::now();
@@ -297,7 +444,7 @@ int main() try {
 		glViewport(0, 0, fbwidth, fbheight);
 
 		// Render Scene
-		renderScene(globalState, fbwidth, fbheight, waves, skybox);
+		renderScene({ globalState.camera, waves, skybox, (float)fbwidth, (float)fbheight });
 
 		// Render ImGui frame
 		ImGui::Render();
@@ -305,12 +452,12 @@ int main() try {
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
 		glfwSwapBuffers(_window);
+		if (firstFrameTime == 0.0)
+			firstFrameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - launch).count();
 
 		processKeys(_window);
 	}
 
-	programShutdown();
-
 	return 0;
 }
 catch (std::exception const& error) {
@@ -319,88 +466,49 @@ catch (std::exception const& error) {
 	return 1;
 }
 
-std::vector<GLuint64> timings;
-
 namespace {
-	void renderScene(GlobalState globalState, float width, float height, std::array<Waves, 3> waves, Skybox skybox) {
+	void renderScene(RenderView const& renderView) {
 		// Matrices
 		glm::mat4 model = glm::mat4(1.0f);
-		glm::mat4 view = globalState.camera.getViewMatrix();
-		glm::mat4 projection = glm::perspective(glm::radians(120.0f), width / height, 0.1f, 1000.f);
-
-		glm::mat4 mvpMatrix = projection * view;
+		glm::mat4 view = renderView.camera.getViewMatrix();
+		glm::mat4 projection = glm::perspective(glm::radians(120.0f), renderView.width / renderView.height, 0.1f, 1000.f);
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Water rendering and shading
-		ShaderManager::enableShader("PBR");
-		glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-		glUniform1i(1, gridSizes[gridSize]);
-
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, waves[0]._displacementTexture);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, waves[1]._displacementTexture);
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, waves[2]._displacementTexture);
-
-		glUniform1i(2, waves[0]._scale);
-		glUniform1i(3, waves[1]._scale);
-		glUniform1i(4, waves[2]._scale);
-
-		glUniform3fv(5, 1, &globalState.camera._position.x);
-		glUniform3fv(6, 1, lightPosPBR);
-		glUniform3fv(7, 1, lightColorPBR);
-
-		glUniform3fv(8, 1, albedo);
-		glUniform1f(9, metallic);
-		glUniform1f(10, roughness);
-		glUniform1f(11, ao);
-
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, waves[0]._derivativesTexture);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, waves[1]._derivativesTexture);
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, waves[2]._derivativesTexture);
-
-		glActiveTexture(GL_TEXTURE6);
-		glBindTexture(GL_TEXTURE_2D, waves[0]._foamTexture);
-		glActiveTexture(GL_TEXTURE7);
-		glBindTexture(GL_TEXTURE_2D, waves[1]._foamTexture);
-		glActiveTexture(GL_TEXTURE8);
-		glBindTexture(GL_TEXTURE_2D, waves[2]._foamTexture);
-
-		glUniform1f(12, foamStrength);
-
-		// Pass wireframe state so we can color the wireframe in black if enabled
-		glUniform1i(13, wireframe);
-
-		glBindVertexArray(globalState.meshVAO);
-		// Wireframe should only alter water mesh
-		glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
-
-		glDrawElements(GL_TRIANGLES, globalState.mesh.indices.size(), GL_UNSIGNED_INT, 0);
-
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		ShaderManager::disableShader();
+		OceanView oceanView{ view, projection, renderView.camera._position, glm::vec2(renderView.width, renderView.height) };
+		renderOcean(renderView.waves, renderView.waves.size(), oceanView, material, wireframe);
 
 		// Skybox
+		GpuProfiler::Scope scope("Skybox");
+
 		glDepthFunc(GL_LEQUAL);
 		ShaderManager::enableShader("Skybox");
 
 		glm::mat4 mvpMatrixMod = projection * glm::mat4(glm::mat3(view)) * model;
 		glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(mvpMatrixMod));
-		glBindVertexArray(skybox._skyboxVAO);
+		glBindVertexArray(renderView.skybox._skyboxVAO);
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, skybox._skyboxTexture);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, renderView.skybox._skyboxTexture);
 		glDrawArrays(GL_TRIANGLES, 0, 36);
 
 		ShaderManager::disableShader();
 		glDepthFunc(GL_LESS);
 	}
 
+	void rebuildMesh(int size) {
+		OceanMesh::deleteBuffers();
+		OceanMesh::initialiseMesh(size, (MeshMode)meshMode);
+		OceanMesh::createVAO();
+	}
+
+	// The clipmap and tiled meshes are the same for every grid size, the others are staged to swap in with it
+	void stageMesh(int size) {
+		OceanMesh::discardStaged();
+		if ((MeshMode)meshMode != MeshMode::Clipmap && (MeshMode)meshMode != MeshMode::Tiled)
+			OceanMesh::stageMesh(size, (MeshMode)meshMode);
+	}
+
 	void processKeys(GLFWwindow* window) {
 		if (GlobalState* globalState = static_cast<GlobalState*>(glfwGetWindowUserPointer(window)))
 		{
@@ -1,26 +1,31 @@
 #include "ComputeShader.h"
+#include "ProgramCache.h"
 
-ComputeShader::ComputeShader() {}
+#include <utility>
 
-ComputeShader::ComputeShader(std::string computeFilename) {
-	_shaderID = ShaderManager::loadShader(GL_COMPUTE_SHADER, computeFilename);
-	_programID = glCreateProgram();
-	glAttachShader(_programID, _shaderID);
-	glLinkProgram(_programID);
+ComputeShader::ComputeShader() {}
 
-	GLint linkStatus;
-	GLint logLength;
-	glGetProgramiv(_programID, GL_LINK_STATUS, &linkStatus);
+ComputeShader::ComputeShader(std::string computeFilename, std::string defines) {
+	_programID = ProgramCache::acquire({ { GL_COMPUTE_SHADER, computeFilename, defines } });
+}
 
-	glGetProgramiv(_programID, GL_INFO_LOG_LENGTH, &logLength);
+ComputeShader::~ComputeShader() {
+	ProgramCache::release(_programID);
+}
 
-	if (linkStatus == GL_FALSE) {
-		std::string errorMessage = std::format("Failed to link shader %s. ", computeFilename);
+ComputeShader::ComputeShader(ComputeShader&& other) noexcept :
+	_programID(std::exchange(other._programID, 0))
+{}
 
-		if (logLength > 0) {
-			std::vector<char> logMessage(logLength + 1);
-			glGetShaderInfoLog(_programID, logLength, nullptr, &logMessage[0]);
-			throw Error("%s %s\n", errorMessage, &logMessage[0]);
-		}
+ComputeShader& ComputeShader::operator=(ComputeShader&& other) noexcept {
+	if (this != &other) {
+		ProgramCache::release(_programID);
+		_programID = std::exchange(other._programID, 0);
 	}
+	return *this;
+}
+
+void ComputeShader::deleteProgram() {
+	ProgramCache::release(_programID);
+	_programID = 0;
 }
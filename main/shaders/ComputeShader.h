@@ -7,12 +7,22 @@
 #include "ShaderManager.h"
 #include "../utils/error.h"
 
+// A compute program from the ProgramCache, shared with every other ComputeShader of the same file and defines.
+// Released to the ProgramCache when destroyed, and move only so every reference to the program is counted once.
 class ComputeShader {
 public:
 	ComputeShader();
-	ComputeShader(std::string computeFilename);
+	ComputeShader(std::string computeFilename, std::string defines = "");
+	~ComputeShader();
 
-	GLuint _programID;
-	GLuint _shaderID;
-};
+	ComputeShader(ComputeShader&& other) noexcept;
+	ComputeShader& operator=(ComputeShader&& other) noexcept;
+	ComputeShader(ComputeShader const&) = delete;
+	ComputeShader& operator=(ComputeShader const&) = delete;
+
+	// Releases the program to the ProgramCache before the destructor would, leaving the ID 0. Needed for
+	// static instances, which outlive the context.
+	void deleteProgram();
 
+	GLuint _programID = 0;
+};
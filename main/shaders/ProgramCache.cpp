@@ -0,0 +1,402 @@
+#include "ProgramCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "ShaderManager.h"
+#include "../utils/error.h"
+#include "../utils/Hash.h"
+#include "../utils/MappedFile.h"
+
+std::map<std::string, ProgramCache::Entry> ProgramCache::_programs;
+std::map<std::string, ProgramCache::Entry> ProgramCache::_reloads;
+std::map<std::string, std::string> ProgramCache::_reloadErrors;
+std::string ProgramCache::_directory;
+bool ProgramCache::_parallelCompile = false;
+bool ProgramCache::_batching = false;
+int ProgramCache::_compiled = 0;
+int ProgramCache::_binaryLoads = 0;
+int ProgramCache::_shared = 0;
+int ProgramCache::_reloaded = 0;
+
+namespace {
+	char const kMagic[4] = { 'W', 'P', 'R', 'G' };
+
+	// KHR_parallel_shader_compile and ARB_parallel_shader_compile, which glad wasn't generated with
+	typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+	GLuint const kMaxCompilerThreads = 0xFFFFFFFF; // Whatever the driver thinks best
+	GLenum const kCompletionStatus = 0x91B1; // GL_COMPLETION_STATUS_KHR
+
+	bool hasExtension(char const* name) {
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++) {
+			if (std::strcmp((char const*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	std::string glString(GLenum name) {
+		char const* string = (char const*)glGetString(name);
+		return string != nullptr ? string : "";
+	}
+}
+
+void ProgramCache::setDirectory(std::string const& directory) {
+	_directory = directory;
+}
+
+bool ProgramCache::enableParallelCompile(GLADloadproc getProcAddress) {
+	PFNGLMAXSHADERCOMPILERTHREADSPROC maxShaderCompilerThreads = nullptr;
+	if (hasExtension("GL_KHR_parallel_shader_compile"))
+		maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSPROC)getProcAddress("glMaxShaderCompilerThreadsKHR");
+	else if (hasExtension("GL_ARB_parallel_shader_compile"))
+		maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSPROC)getProcAddress("glMaxShaderCompilerThreadsARB");
+
+	if (maxShaderCompilerThreads == nullptr)
+		return false;
+
+	maxShaderCompilerThreads(kMaxCompilerThreads);
+	_parallelCompile = true;
+	return true;
+}
+
+bool ProgramCache::isParallelCompileEnabled() {
+	return _parallelCompile;
+}
+
+GLuint ProgramCache::acquire(std::vector<Stage> const& stages) {
+	std::string name;
+	for (Stage const& stage : stages)
+		name += std::to_string(stage.type) + ":" + stage.fileName + ":" + stage.defines + ";";
+
+	auto existing = _programs.find(name);
+	if (existing != _programs.end()) {
+		existing->second.users++;
+		_shared++;
+		return existing->second.program;
+	}
+
+	uint64_t key = 0;
+	GLuint program = 0;
+	if (!_directory.empty()) {
+		key = binaryKey(stages);
+		program = loadBinary(key);
+	}
+
+	if (program != 0) {
+		_programs.emplace(name, Entry{ program, 1, stages });
+		return program;
+	}
+
+	Entry entry = submit(stages, !_directory.empty());
+	entry.key = key;
+	Entry& added = _programs.emplace(name, entry).first->second;
+	if (!_batching)
+		finish(added);
+
+	return added.program;
+}
+
+void ProgramCache::release(GLuint program) {
+	if (program == 0)
+		return;
+
+	for (auto entry = _programs.begin(); entry != _programs.end(); ++entry) {
+		if (entry->second.program != program)
+			continue;
+
+		if (--entry->second.users == 0) {
+			auto reload = _reloads.find(entry->first);
+			if (reload != _reloads.end()) {
+				deleteEntry(reload->second);
+				_reloads.erase(reload);
+			}
+			_reloadErrors.erase(entry->first);
+
+			deleteEntry(entry->second);
+			_programs.erase(entry);
+		}
+		return;
+	}
+}
+
+void ProgramCache::beginBatch() {
+	_batching = true;
+}
+
+void ProgramCache::endBatch() {
+	_batching = false;
+
+	for (auto& [name, entry] : _programs)
+		finish(entry);
+}
+
+void ProgramCache::reload(std::string const& fileName) {
+	std::filesystem::path changed = std::filesystem::path(fileName).lexically_normal();
+
+	for (auto& [name, entry] : _programs) {
+		bool usesFile = std::any_of(entry.stages.begin(), entry.stages.end(), [&](Stage const& stage) {
+			return std::filesystem::path(stage.fileName).lexically_normal() == changed;
+		});
+		if (!usesFile)
+			continue;
+
+		// A newer save replaces a reload that hasn't finished yet
+		auto pending = _reloads.find(name);
+		if (pending != _reloads.end()) {
+			deleteEntry(pending->second);
+			_reloads.erase(pending);
+		}
+
+		// A file caught in the middle of being saved can't be read, which is checked before any GL object is created
+		uint64_t key = 0;
+		try {
+			key = binaryKey(entry.stages);
+		}
+		catch (Error const& error) {
+			_reloadErrors[name] = error.what();
+			continue;
+		}
+
+		Entry replacement = submit(entry.stages, true);
+		replacement.key = _directory.empty() ? 0 : key;
+		_reloads.emplace(name, replacement);
+	}
+}
+
+void ProgramCache::updateReloads() {
+	for (auto reload = _reloads.begin(); reload != _reloads.end(); ) {
+		Entry& replacement = reload->second;
+
+		// Without the parallel compile extensions the query below waits for the driver instead
+		if (_parallelCompile) {
+			GLint completed;
+			glGetProgramiv(replacement.program, kCompletionStatus, &completed);
+			if (completed == GL_FALSE) {
+				++reload;
+				continue;
+			}
+		}
+
+		std::string error = getLinkError(replacement);
+		if (!error.empty()) {
+			_reloadErrors[reload->first] = error;
+		}
+		else {
+			replaceProgram(_programs.at(reload->first), replacement);
+			_reloadErrors.erase(reload->first);
+			_reloaded++;
+		}
+
+		deleteEntry(replacement);
+		reload = _reloads.erase(reload);
+	}
+}
+
+std::map<std::string, std::string> const& ProgramCache::getReloadErrors() {
+	return _reloadErrors;
+}
+
+int ProgramCache::getCompiledCount() {
+	return _compiled;
+}
+
+int ProgramCache::getBinaryLoadCount() {
+	return _binaryLoads;
+}
+
+int ProgramCache::getSharedCount() {
+	return _shared;
+}
+
+int ProgramCache::getReloadCount() {
+	return _reloaded;
+}
+
+ProgramCache::Entry ProgramCache::submit(std::vector<Stage> const& stages, bool retrievable) {
+	Entry entry{ glCreateProgram(), 1, stages };
+	entry.pending = true;
+
+	for (Stage const& stage : stages) {
+		entry.shaders.push_back(ShaderManager::submitShader(stage.type, stage.fileName, stage.defines));
+		glAttachShader(entry.program, entry.shaders.back());
+	}
+
+	if (retrievable)
+		glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(entry.program);
+
+	return entry;
+}
+
+void ProgramCache::finish(Entry& entry) {
+	if (!entry.pending)
+		return;
+
+	// The first query of each waits for the driver, which by now has had every submitted program to work on
+	std::string error = getLinkError(entry);
+	if (!error.empty())
+		throw Error("%s", error.c_str());
+
+	// The program keeps what it needs from the shaders
+	for (GLuint shader : entry.shaders) {
+		glDetachShader(entry.program, shader);
+		glDeleteShader(shader);
+	}
+	entry.shaders.clear();
+	entry.pending = false;
+
+	if (entry.key != 0)
+		storeBinary(entry.key, entry.program);
+
+	_compiled++;
+}
+
+std::string ProgramCache::getLinkError(Entry const& entry) {
+	GLint linkStatus;
+	glGetProgramiv(entry.program, GL_LINK_STATUS, &linkStatus);
+	if (linkStatus == GL_TRUE)
+		return "";
+
+	// A shader that didn't compile explains the failed link best
+	for (size_t i = 0; i < entry.shaders.size(); i++) {
+		std::string error = ShaderManager::getCompileError(entry.shaders[i], entry.stages[i].fileName);
+		if (!error.empty())
+			return error;
+	}
+
+	GLint logLength;
+	glGetProgramiv(entry.program, GL_INFO_LOG_LENGTH, &logLength);
+	std::vector<char> logMessage(logLength + 1);
+	if (logLength > 0)
+		glGetProgramInfoLog(entry.program, logLength, nullptr, &logMessage[0]);
+	return "Failed to link program " + entry.stages.front().fileName + ". " + &logMessage[0] + "\n";
+}
+
+void ProgramCache::replaceProgram(Entry& entry, Entry const& replacement) {
+	// The replacement's binary carries its executable over. A driver without binary formats (or one that
+	// rejects its own binary) links the program again from the replacement's shaders, which are known to link.
+	GLint length = 0;
+	glGetProgramiv(replacement.program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	GLint linkStatus = GL_FALSE;
+	if (length > 0) {
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(replacement.program, length, nullptr, &format, binary.data());
+		glProgramBinary(entry.program, format, binary.data(), length);
+		glGetProgramiv(entry.program, GL_LINK_STATUS, &linkStatus);
+	}
+
+	if (linkStatus == GL_FALSE) {
+		for (GLuint shader : replacement.shaders)
+			glAttachShader(entry.program, shader);
+		glLinkProgram(entry.program);
+		for (GLuint shader : replacement.shaders)
+			glDetachShader(entry.program, shader);
+	}
+
+	entry.key = replacement.key;
+	if (entry.key != 0)
+		storeBinary(entry.key, replacement.program);
+}
+
+void ProgramCache::deleteEntry(Entry& entry) {
+	for (GLuint shader : entry.shaders)
+		glDeleteShader(shader);
+	glDeleteProgram(entry.program);
+
+	entry.shaders.clear();
+	entry.program = 0;
+}
+
+uint64_t ProgramCache::binaryKey(std::vector<Stage> const& stages) {
+	// The sources decide the binary, so an edited shader is a miss rather than a stale program
+	uint64_t key = hashBytes(&kVersion, sizeof(kVersion));
+	for (GLenum driverString : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		std::string string = glString(driverString);
+		key = hashBytes(string.data(), string.size(), key);
+	}
+	for (Stage const& stage : stages) {
+		std::string source = ShaderManager::readShaderSource(stage.fileName, stage.defines);
+		key = hashBytes(&stage.type, sizeof(stage.type), key);
+		key = hashBytes(source.data(), source.size(), key);
+	}
+
+	return key;
+}
+
+GLuint ProgramCache::loadBinary(uint64_t key) {
+	MappedFile file(binaryPath(key));
+	if (!file.isOpen() || file.size() < sizeof(BinaryHeader))
+		return 0;
+
+	BinaryHeader header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || header.key != key
+		|| file.size() != sizeof(BinaryHeader) + header.length)
+		return 0;
+
+	// A driver update can make an old binary unusable even under the same version string
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.format, file.data() + sizeof(BinaryHeader), (GLsizei)header.length);
+
+	GLint linkStatus;
+	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+	if (linkStatus == GL_FALSE) {
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	_binaryLoads++;
+	return program;
+}
+
+void ProgramCache::storeBinary(uint64_t key, GLuint program) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+	BinaryHeader header{};
+	std::memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.key = key;
+	header.format = format;
+	header.length = (uint32_t)length;
+
+	// Written to a temporary name and renamed, so a reader never maps a half written binary
+	std::error_code error;
+	std::filesystem::create_directories(_directory, error);
+	std::string path = binaryPath(key);
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary);
+		file.write((char const*)&header, sizeof(header));
+		file.write(binary.data(), binary.size());
+
+		if (!file) {
+			std::fprintf(stderr, "Could not write program binary: %s\n", temporaryPath.c_str());
+			return;
+		}
+	}
+
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+		std::fprintf(stderr, "Could not write program binary: %s (%s)\n", path.c_str(), error.message().c_str());
+}
+
+std::string ProgramCache::binaryPath(uint64_t key) {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.program", (unsigned long long)key);
+	return (std::filesystem::path(_directory) / name).string();
+}
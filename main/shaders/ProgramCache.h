@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Every program of the application, linked once per process and shared: acquiring the same stages again
+// returns the same program and counts another user, and the program is deleted when the last one releases it.
+//
+// With a directory set, linked programs are also kept on disk with glGetProgramBinary, keyed by a hash of the
+// stages' sources (defines included) and the GL vendor, renderer and version strings, and later launches load
+// them with glProgramBinary. A binary the driver rejects is compiled from source instead and stored again.
+//
+// Between beginBatch() and endBatch() programs are compiled and linked without waiting for the result, so
+// with KHR/ARB_parallel_shader_compile the driver works on all of them at once. Their IDs can be used straight
+// away (GL waits for the link at first use), but errors only surface from endBatch().
+//
+// reload() rebuilds the programs of an edited file while the old ones keep running. Once a new program has
+// linked, updateReloads() moves its executable into the program object everything already holds, so the ID
+// stays the same and no holder has to be told about it.
+class ProgramCache {
+public:
+	// Bumped whenever the file layout changes, older binaries are then misses
+	static constexpr uint32_t kVersion = 1;
+
+	struct Stage {
+		GLenum type;
+		std::string fileName;
+		std::string defines; // Inserted after the #version directive, see ShaderManager::loadShader
+	};
+
+	// Where binaries are read and written, empty (the default) keeps programs in memory only
+	static void setDirectory(std::string const& directory);
+	// Lets the driver compile on as many threads as it likes, false if it has neither parallel compile extension
+	static bool enableParallelCompile(GLADloadproc getProcAddress);
+	static bool isParallelCompileEnabled();
+
+	static GLuint acquire(std::vector<Stage> const& stages);
+	// 0 is ignored
+	static void release(GLuint program);
+
+	static void beginBatch();
+	// Waits for every program acquired since beginBatch(), throws if one of them failed to compile or link
+	static void endBatch();
+
+	// Starts compiling every program built from fileName again, without waiting for it
+	static void reload(std::string const& fileName);
+	// Call once a frame on the GL thread: swaps in the reloaded programs that have finished linking. One that
+	// failed keeps running its last good version, and its error is listed until a later reload of it links.
+	static void updateReloads();
+	// The compile or link log of every program whose last reload failed
+	static std::map<std::string, std::string> const& getReloadErrors();
+
+	// Since the process started
+	static int getCompiledCount();
+	static int getBinaryLoadCount();
+	static int getSharedCount();
+	static int getReloadCount();
+
+private:
+	struct Entry {
+		GLuint program;
+		int users;
+
+		// What reload() rebuilds it from
+		std::vector<Stage> stages;
+
+		// Until finish() has checked the link, the shaders it was linked from and where to store its binary
+		bool pending = false;
+		std::vector<GLuint> shaders;
+		uint64_t key = 0;
+	};
+
+	struct BinaryHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		uint32_t length;
+	};
+
+	// retrievable asks the driver to keep the binary around for glGetProgramBinary
+	static Entry submit(std::vector<Stage> const& stages, bool retrievable);
+	static void finish(Entry& entry);
+	// The message finish() throws, empty if the program linked
+	static std::string getLinkError(Entry const& entry);
+	static void replaceProgram(Entry& entry, Entry const& replacement);
+	static void deleteEntry(Entry& entry);
+	static uint64_t binaryKey(std::vector<Stage> const& stages);
+	static GLuint loadBinary(uint64_t key);
+	static void storeBinary(uint64_t key, GLuint program);
+	static std::string binaryPath(uint64_t key);
+
+	static std::map<std::string, Entry> _programs; // By stage types, file names and defines
+	static std::map<std::string, Entry> _reloads; // Submitted by reload(), by the name of the program they replace
+	static std::map<std::string, std::string> _reloadErrors;
+	static std::string _directory;
+	static bool _parallelCompile;
+	static bool _batching;
+	static int _compiled;
+	static int _binaryLoads;
+	static int _shared;
+	static int _reloaded;
+};
@@ -3,10 +3,12 @@
 #include <string>
 #include <format>
 
+// A graphics program from the ProgramCache, shared with every other Shader of the same files
 class Shader {
 public:
 	Shader();
 	Shader(std::string vertexFileName, std::string fragmentFileName);
+	Shader(std::string vertexFileName, std::string tessControlFileName, std::string tessEvaluationFileName, std::string fragmentFileName);
 
 	void compile();
 	void deleteShaders();
@@ -18,8 +20,7 @@ public:
 	int shaderProgram = -1;
 private:
 	std::string vertexFile;
+	std::string tessControlFile; // Both empty without tessellation
+	std::string tessEvaluationFile;
 	std::string fragmentFile;
-
-	int vertexShader = -1;
-	int fragmentShader = -1;
 };
\ No newline at end of file
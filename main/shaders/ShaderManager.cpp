@@ -5,11 +5,11 @@ std::map<std::string, Shader> ShaderManager::shaders;
 
 void ShaderManager::initialiseShaders() {
 	shaders.emplace("PBR", PBRShader());
+	shaders.emplace("PBRTessellation", PBRTessellationShader());
 	shaders.emplace("Skybox", SkyboxShader());
 }
 
-GLuint ShaderManager::loadShader(GLenum shaderType, const std::string &fileName) {	
-	// Read shader file
+std::string ShaderManager::readShaderSource(const std::string &fileName, const std::string &defines) {
 	std::string shaderSource;
 	std::ifstream shaderFile(fileName, std::ios::in);
 
@@ -19,39 +19,62 @@ GLuint ShaderManager::loadShader(GLenum shaderType, const std::string &fileName)
 		shaderSource = buffer.str();
 	}
 	else {
-		throw Error("Could not open shader file: %s\n", fileName);
+		throw Error("Could not open shader file: %s\n", fileName.c_str());
 	}
 
-	// Compile shader
+	// #version has to stay the first line
+	if (!defines.empty())
+		shaderSource.insert(shaderSource.find('\n') + 1, defines);
+
+	return shaderSource;
+}
+
+GLuint ShaderManager::loadShader(GLenum shaderType, const std::string &fileName, const std::string &defines) {
+	GLuint shaderID = submitShader(shaderType, fileName, defines);
+	checkShader(shaderID, fileName);
+	return shaderID;
+}
+
+GLuint ShaderManager::submitShader(GLenum shaderType, const std::string &fileName, const std::string &defines) {
+	std::string shaderSource = readShaderSource(fileName, defines);
+
 	GLuint shaderID = glCreateShader(shaderType);
 	char const* shaderSourcePointer = shaderSource.c_str();
 
 	glShaderSource(shaderID, 1, &shaderSourcePointer, nullptr);
 	glCompileShader(shaderID);
 
-	// Check shader compilation status
+	return shaderID;
+}
+
+void ShaderManager::checkShader(GLuint shaderID, const std::string &fileName) {
+	std::string error = getCompileError(shaderID, fileName);
+
+	if (!error.empty()) {
+		glDeleteShader(shaderID);
+		throw Error("%s", error.c_str());
+	}
+}
+
+std::string ShaderManager::getCompileError(GLuint shaderID, const std::string &fileName) {
 	GLint compilationStatus;
 	GLint logLength;
 	glGetShaderiv(shaderID, GL_COMPILE_STATUS, &compilationStatus);
 	glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &logLength);
 
-	if (compilationStatus == GL_FALSE) {
-		std::string errorMessage = std::format("Failed to compile shader %s. ", fileName.c_str());
+	if (compilationStatus == GL_TRUE)
+		return "";
 
-		if (logLength > 0) {
-			std::vector<char> logMessage(logLength + 1);
-			glGetShaderInfoLog(shaderID, logLength, nullptr, &logMessage[0]);
-			throw Error("%s %s\n", errorMessage, &logMessage[0]);
-		}
-	}
-
-	return shaderID;
+	std::vector<char> logMessage(logLength + 1);
+	if (logLength > 0)
+		glGetShaderInfoLog(shaderID, logLength, nullptr, &logMessage[0]);
+	return "Failed to compile shader " + fileName + ". " + &logMessage[0] + "\n";
 }
 
-void ShaderManager::enableShader(std::string shaderName) {
-	// Try to get the requested shader instance
+void ShaderManager::enableShader(std::string const& shaderName) {
+	// Try to get the requested shader instance, by reference as this runs every frame
 	try {
-		Shader shader = shaders.at(shaderName);
+		Shader& shader = shaders.at(shaderName);
 		shader.enable();
 	}
 	// If shader isn't in map
@@ -64,6 +87,12 @@ Shader ShaderManager::getShaderInstance(std::string shaderName) {
 	return shaders.at(shaderName);
 }
 
+void ShaderManager::deleteShaders() {
+	for (auto& [name, shader] : shaders)
+		shader.deleteShaders();
+	shaders.clear();
+}
+
 void ShaderManager::disableShader() {
 	glUseProgram(0);
 }
@@ -18,6 +18,12 @@ public:
 	PBRShader() : Shader("../shaders/PBR.vert", "../shaders/PBR.frag") {}
 };
 
+// PBR with the ocean's patches subdivided by their size on screen (MeshMode::Tessellation)
+class PBRTessellationShader : public Shader {
+public:
+	PBRTessellationShader() : Shader("../shaders/PBR.vert", "../shaders/PBR.tesc", "../shaders/PBR.tese", "../shaders/PBR.frag") {}
+};
+
 class SkyboxShader : public Shader {
 public:
 	SkyboxShader() : Shader("../shaders/Skybox.vert", "../shaders/Skybox.frag") {}
@@ -27,8 +33,17 @@ class ShaderManager {
 public:
 	static void initialiseShaders();
 
-	static GLuint loadShader(GLenum shaderType, const std::string &fileName);
-	static void enableShader(std::string shaderName);
+	// defines are inserted after the #version directive, e.g. "#define NAME value\n"
+	static std::string readShaderSource(const std::string &fileName, const std::string &defines = "");
+	static GLuint loadShader(GLenum shaderType, const std::string &fileName, const std::string &defines = "");
+	// loadShader in two halves: submitShader starts the compile without waiting for it, checkShader waits and
+	// throws with the log if it failed. Submitting every shader before checking any lets the driver compile in parallel.
+	static GLuint submitShader(GLenum shaderType, const std::string &fileName, const std::string &defines = "");
+	static void checkShader(GLuint shaderID, const std::string &fileName);
+	// The message checkShader throws, empty if the shader compiled
+	static std::string getCompileError(GLuint shaderID, const std::string &fileName);
+	static void deleteShaders();
+	static void enableShader(std::string const& shaderName);
 	static void disableShader();
 	static Shader getShaderInstance(std::string shaderName);
 private:
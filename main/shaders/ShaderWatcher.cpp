@@ -0,0 +1,107 @@
+#include "ShaderWatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+#include "../utils/error.h"
+
+#if defined(__linux__)
+#	include <poll.h>
+#	include <sys/inotify.h>
+#	include <unistd.h>
+#endif
+
+namespace {
+	// How long the thread waits for changes before checking whether it should stop
+	int const kPollMilliseconds = 250;
+}
+
+ShaderWatcher::ShaderWatcher(std::string const& directory) : _directory(directory) {
+#if defined(__linux__)
+	_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_inotify < 0)
+		throw Error("inotify_init1() failed to watch the shaders");
+
+	// Editors either write the file in place or write a new one and rename it over the old
+	if (inotify_add_watch(_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		close(_inotify);
+		throw Error("Could not watch shader directory: %s", directory.c_str());
+	}
+#else
+	std::error_code error;
+	for (auto const& file : std::filesystem::directory_iterator(directory, error))
+		_writeTimes[file.path().filename().string()] = file.last_write_time(error).time_since_epoch().count();
+	if (error)
+		throw Error("Could not watch shader directory: %s (%s)", directory.c_str(), error.message().c_str());
+#endif
+
+	_thread = std::thread(&ShaderWatcher::watchLoop, this);
+}
+
+ShaderWatcher::~ShaderWatcher() {
+	_stopping = true;
+	_thread.join();
+
+#if defined(__linux__)
+	close(_inotify);
+#endif
+}
+
+std::vector<std::string> ShaderWatcher::takeChanges() {
+	std::vector<std::string> changes;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	changes.swap(_changes);
+	return changes;
+}
+
+#if defined(__linux__)
+void ShaderWatcher::watchLoop() {
+	alignas(inotify_event) char buffer[4096];
+
+	while (!_stopping) {
+		pollfd descriptor{ _inotify, POLLIN, 0 };
+		if (poll(&descriptor, 1, kPollMilliseconds) <= 0)
+			continue;
+
+		ssize_t length;
+		while ((length = read(_inotify, buffer, sizeof(buffer))) > 0) {
+			for (char* next = buffer; next < buffer + length; ) {
+				inotify_event const* event = (inotify_event const*)next;
+				if (event->len > 0)
+					addChange(event->name);
+				next += sizeof(inotify_event) + event->len;
+			}
+		}
+	}
+}
+#else
+void ShaderWatcher::watchLoop() {
+	while (!_stopping) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(kPollMilliseconds));
+
+		std::error_code error;
+		for (auto const& file : std::filesystem::directory_iterator(_directory, error)) {
+			long long writeTime = file.last_write_time(error).time_since_epoch().count();
+			if (error)
+				continue;
+
+			long long& known = _writeTimes[file.path().filename().string()];
+			if (known != writeTime) {
+				known = writeTime;
+				addChange(file.path().filename().string());
+			}
+		}
+	}
+}
+#endif
+
+void ShaderWatcher::addChange(std::string const& fileName) {
+	std::string path = (std::filesystem::path(_directory) / fileName).string();
+
+	// An editor can write a file several times for one save
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (std::find(_changes.begin(), _changes.end(), path) == _changes.end())
+		_changes.push_back(path);
+}
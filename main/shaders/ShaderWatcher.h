@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches a directory of shaders on a thread of its own and collects the files saved in it, for the render
+// thread to pick up with takeChanges() and hand to ProgramCache::reload(). On Linux the thread waits on
+// inotify, elsewhere it compares the files' modification times a few times a second.
+class ShaderWatcher {
+public:
+	explicit ShaderWatcher(std::string const& directory);
+	~ShaderWatcher();
+
+	ShaderWatcher(ShaderWatcher const&) = delete;
+	ShaderWatcher& operator=(ShaderWatcher const&) = delete;
+
+	// Paths (the directory joined with the file name) of the files saved since the last call, each once
+	std::vector<std::string> takeChanges();
+
+private:
+	void watchLoop();
+	void addChange(std::string const& fileName);
+
+	std::string _directory;
+	std::thread _thread;
+	std::atomic<bool> _stopping = false;
+
+	std::mutex _mutex;
+	std::vector<std::string> _changes;
+
+#if defined(__linux__)
+	int _inotify = -1;
+#else
+	std::map<std::string, long long> _writeTimes; // By file name, only touched by the watching thread
+#endif
+};
@@ -0,0 +1,213 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+
+#include "error.h"
+
+std::deque<GpuProfiler::Stage> GpuProfiler::_stages;
+long long GpuProfiler::_frame = 0;
+bool GpuProfiler::_enabled = true;
+
+std::string GpuProfiler::Stage::label() const {
+	char buffer[128];
+	formatLabel(buffer, sizeof(buffer));
+	return buffer;
+}
+
+void GpuProfiler::Stage::formatLabel(char* buffer, size_t size) const {
+	if (index < 0)
+		std::snprintf(buffer, size, "%s", name.c_str());
+	else
+		std::snprintf(buffer, size, "%s [%d]", name.c_str(), index);
+}
+
+float GpuProfiler::Stage::latest() const {
+	if (historyCount == 0)
+		return 0.0f;
+
+	return history[(historyHead + kHistorySize - 1) % kHistorySize];
+}
+
+float GpuProfiler::Stage::average() const {
+	if (historyCount == 0)
+		return 0.0f;
+
+	float sum = 0.0f;
+	for (int i = 0; i < historyCount; i++)
+		sum += history[i];
+
+	return sum / historyCount;
+}
+
+float GpuProfiler::Stage::percentile(float p) const {
+	if (historyCount == 0)
+		return 0.0f;
+
+	std::array<float, kHistorySize> sorted = history;
+	std::sort(sorted.begin(), sorted.begin() + historyCount);
+
+	int rank = std::clamp((int)(p * (historyCount - 1) + 0.5f), 0, historyCount - 1);
+	return sorted[rank];
+}
+
+std::vector<float> GpuProfiler::Stage::orderedHistory() const {
+	std::vector<float> ordered;
+	ordered.reserve(historyCount);
+
+	int start = historyCount < kHistorySize ? 0 : historyHead;
+	for (int i = 0; i < historyCount; i++)
+		ordered.push_back(history[(start + i) % kHistorySize]);
+
+	return ordered;
+}
+
+GpuProfiler::Scope::Scope(char const* name, int index) {
+	if (!_enabled)
+		return;
+
+	Stage* stage = findStage(name, index);
+
+	// A stage can only be timed once per frame, its query for this frame is already in use
+	if (stage->lastFrame == _frame)
+		return;
+
+	_stage = stage;
+	_slot = (int)(_frame % kFrameLatency);
+
+	// The previous result from this slot wasn't collected in beginFrame(), so it's lost
+	if (_stage->pending[_slot]) {
+		_stage->pending[_slot] = false;
+		_stage->dropped++;
+	}
+
+	_stage->lastFrame = _frame;
+	glQueryCounter(_stage->queries[_slot][0], GL_TIMESTAMP);
+}
+
+GpuProfiler::Scope::~Scope() {
+	if (_stage == nullptr)
+		return;
+
+	glQueryCounter(_stage->queries[_slot][1], GL_TIMESTAMP);
+	_stage->pending[_slot] = true;
+}
+
+void GpuProfiler::beginFrame() {
+	_frame++;
+
+	// Collect whatever is ready from the frame that last used this frame's slot, without waiting
+	int slot = (int)(_frame % kFrameLatency);
+	for (Stage& stage : _stages)
+		collect(stage, slot, false);
+}
+
+void GpuProfiler::flush() {
+	// Waits for every outstanding query, only for use outside of the frame loop (e.g. benchmarks)
+	for (Stage& stage : _stages)
+		for (int slot = 0; slot < kFrameLatency; slot++)
+			collect(stage, slot, true);
+}
+
+void GpuProfiler::reset() {
+	for (Stage& stage : _stages)
+		glDeleteQueries(kFrameLatency * 2, &stage.queries[0][0]);
+
+	_stages.clear();
+	_frame = 0;
+}
+
+void GpuProfiler::setEnabled(bool enabled) {
+	_enabled = enabled;
+}
+
+bool GpuProfiler::isEnabled() {
+	return _enabled;
+}
+
+std::deque<GpuProfiler::Stage> const& GpuProfiler::getStages() {
+	return _stages;
+}
+
+long long GpuProfiler::getFrame() {
+	return _frame;
+}
+
+void GpuProfiler::dump(std::ostream& out) {
+	out << "{\n";
+	out << "  \"renderer\": \"" << glGetString(GL_RENDERER) << "\",\n";
+	out << "  \"frame\": " << _frame << ",\n";
+	out << "  \"stages\": [\n";
+
+	char line[512];
+	for (size_t i = 0; i < _stages.size(); i++) {
+		Stage const& stage = _stages[i];
+
+		std::snprintf(line, sizeof(line),
+			"    { \"name\": \"%s\", \"index\": %d, \"samples\": %d, \"dropped\": %d, \"avg_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"max_ms\": %.4f, \"history_ms\": [",
+			stage.name.c_str(), stage.index, stage.historyCount, stage.dropped,
+			stage.average(), stage.percentile(0.5f), stage.percentile(0.95f), stage.percentile(1.0f));
+		out << line;
+
+		std::vector<float> history = stage.orderedHistory();
+		for (size_t j = 0; j < history.size(); j++) {
+			std::snprintf(line, sizeof(line), "%s%.4f", j == 0 ? "" : ", ", history[j]);
+			out << line;
+		}
+
+		out << "] }" << (i + 1 < _stages.size() ? "," : "") << "\n";
+	}
+
+	out << "  ]\n";
+	out << "}\n";
+}
+
+void GpuProfiler::dumpToFile(std::string const& fileName) {
+	std::ofstream file(fileName);
+
+	if (!file.is_open())
+		throw Error("Could not open profiler output file: %s\n", fileName.c_str());
+
+	dump(file);
+}
+
+void GpuProfiler::collect(Stage& stage, int slot, bool wait) {
+	if (!stage.pending[slot])
+		return;
+
+	// Queries complete in order, so the start timestamp is ready whenever the end one is
+	GLuint available = GL_FALSE;
+	if (wait)
+		available = GL_TRUE;
+	else
+		glGetQueryObjectuiv(stage.queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+	if (available == GL_FALSE)
+		return;
+
+	GLuint64 start = 0;
+	GLuint64 end = 0;
+	glGetQueryObjectui64v(stage.queries[slot][0], GL_QUERY_RESULT, &start);
+	glGetQueryObjectui64v(stage.queries[slot][1], GL_QUERY_RESULT, &end);
+	stage.pending[slot] = false;
+
+	stage.history[stage.historyHead] = (float)((end - start) / 1.0e6);
+	stage.historyHead = (stage.historyHead + 1) % kHistorySize;
+	stage.historyCount = std::min(stage.historyCount + 1, kHistorySize);
+}
+
+GpuProfiler::Stage* GpuProfiler::findStage(char const* name, int index) {
+	for (Stage& stage : _stages) {
+		if (stage.index == index && std::strcmp(stage.name.c_str(), name) == 0)
+			return &stage;
+	}
+
+	Stage& stage = _stages.emplace_back();
+	stage.name = name;
+	stage.index = index;
+	glGenQueries(kFrameLatency * 2, &stage.queries[0][0]);
+
+	return &stage;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "glad/glad.h"
+
+// Per-stage GPU timings using pairs of GL_TIMESTAMP queries.
+//
+// Every stage owns one pair of query objects per in-flight frame. A frame's results are only read
+// back once the driver reports them available (normally one frame later), so timing never stalls
+// the pipeline. Results that aren't ready by the time their queries are reused are dropped.
+//
+// Timestamps are used rather than GL_TIME_ELAPSED as they can be nested, and because llvmpipe
+// reports zero elapsed time for compute dispatches.
+class GpuProfiler {
+public:
+	static constexpr int kFrameLatency = 2;
+	static constexpr int kHistorySize = 128;
+
+	struct Stage {
+		std::string name;
+		int index = -1; // Cascade index, -1 for stages that aren't per cascade
+
+		GLuint queries[kFrameLatency][2] = {}; // Start and end timestamp
+		bool pending[kFrameLatency] = {};
+		long long lastFrame = -1;
+
+		// Ring buffer of the most recent results, in milliseconds
+		std::array<float, kHistorySize> history = {};
+		int historyHead = 0;
+		int historyCount = 0;
+		int dropped = 0;
+
+		std::string label() const;
+		// label() into a buffer, for callers that run every frame
+		void formatLabel(char* buffer, size_t size) const;
+		float latest() const;
+		float average() const;
+		float percentile(float p) const;
+		// Samples from oldest to newest
+		std::vector<float> orderedHistory() const;
+	};
+
+	class Scope {
+	public:
+		Scope(char const* name, int index = -1);
+		~Scope();
+
+		Scope(Scope const&) = delete;
+		Scope& operator=(Scope const&) = delete;
+
+	private:
+		Stage* _stage = nullptr;
+		int _slot = 0;
+	};
+
+	static void beginFrame();
+	static void flush();
+	static void reset();
+
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	static std::deque<Stage> const& getStages();
+	static long long getFrame();
+
+	static void dump(std::ostream& out);
+	static void dumpToFile(std::string const& fileName);
+
+private:
+	static void collect(Stage& stage, int slot, bool wait);
+	static Stage* findStage(char const* name, int index);
+
+	// A deque so Stage pointers held by active scopes survive new stages being added
+	static std::deque<Stage> _stages;
+	static long long _frame;
+	static bool _enabled;
+};
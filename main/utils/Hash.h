@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64 bit FNV-1a, for cache keys. Chain calls by passing the previous hash.
+inline uint64_t hashBytes(void const* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+	unsigned char const* bytes = (unsigned char const*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
@@ -0,0 +1,85 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+MappedFile::MappedFile(std::string const& fileName) {
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER size;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return;
+	}
+
+	_data = (unsigned char const*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (_data == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return;
+	}
+
+	_size = (size_t)size.QuadPart;
+	_file = file;
+	_mapping = mapping;
+}
+
+MappedFile::~MappedFile() {
+	if (_data == nullptr)
+		return;
+
+	UnmapViewOfFile(_data);
+	CloseHandle(_mapping);
+	CloseHandle(_file);
+}
+#else
+MappedFile::MappedFile(std::string const& fileName) {
+	int file = open(fileName.c_str(), O_RDONLY);
+	if (file == -1)
+		return;
+
+	// The mapping keeps the file alive, the descriptor isn't needed past mmap
+	struct stat status;
+	if (fstat(file, &status) == 0 && status.st_size > 0) {
+		void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (data != MAP_FAILED) {
+			_data = (unsigned char const*)data;
+			_size = (size_t)status.st_size;
+		}
+	}
+
+	close(file);
+}
+
+MappedFile::~MappedFile() {
+	if (_data != nullptr)
+		munmap((void*)_data, _size);
+}
+#endif
+
+bool MappedFile::isOpen() const {
+	return _data != nullptr;
+}
+
+unsigned char const* MappedFile::data() const {
+	return _data;
+}
+
+size_t MappedFile::size() const {
+	return _size;
+}
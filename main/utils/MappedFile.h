@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// A whole file mapped read only into memory, unmapped when destroyed. The pages are read in by the OS as
+// they're touched, so e.g. a texture upload straight from data() copies the file only once.
+class MappedFile {
+public:
+	// Leaves the file unmapped (isOpen() false) if it doesn't exist or can't be mapped
+	explicit MappedFile(std::string const& fileName);
+	~MappedFile();
+
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+
+	bool isOpen() const;
+	unsigned char const* data() const;
+	size_t size() const;
+
+private:
+	unsigned char const* _data = nullptr;
+	size_t _size = 0;
+
+#if defined(_WIN32)
+	void* _file = nullptr;
+	void* _mapping = nullptr;
+#endif
+};
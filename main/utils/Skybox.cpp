@@ -1,4 +1,5 @@
 #include "Skybox.h"
+#include "ThreadPool.h"
 
 float skyboxVertices[] = {
     // positions          
@@ -45,24 +46,36 @@ float skyboxVertices[] = {
      1.0f, -1.0f,  1.0f
 };
 
-Skybox::Skybox(std::vector<std::string> faces) {
+std::vector<Skybox::Face> Skybox::loadFaces(std::vector<std::string> const& fileNames) {
+	std::vector<Face> faces(fileNames.size());
+
+	// stbi_load is thread safe, and an exception mustn't escape a worker so failures are checked afterwards
+	ThreadPool threads((int)fileNames.size());
+	threads.parallelFor((int)fileNames.size(), [&](int i) {
+		int channels;
+		faces[i].pixels.reset(stbi_load(fileNames[i].c_str(), &faces[i].width, &faces[i].height, &channels, 3));
+	});
+
+	for (size_t i = 0; i < faces.size(); i++) {
+		if (!faces[i].pixels)
+			throw Error("Cubemap tetxure failed to load. Texture: %s", fileNames[i].c_str());
+	}
+
+	return faces;
+}
+
+Skybox::Skybox(std::vector<std::string> faces) : Skybox(loadFaces(faces)) {}
+
+Skybox::Skybox(std::vector<Face> const& faces) {
 	_skyboxTexture = 0;
 	glGenTextures(1, &_skyboxTexture);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, _skyboxTexture);
 
-	int width, height, nrChannels;
-	for (int i = 0; i < faces.size(); i++) {
-		unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-
-		if (data) {
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-			stbi_image_free(data);
-		}
-		else {
-			throw Error("Cubemap tetxure failed to load. Texture: %s", faces[i].c_str());
-			stbi_image_free(data);
-		}
-	}
+	// Rows of RGB pixels aren't necessarily 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t i = 0; i < faces.size(); i++)
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, faces[i].width, faces[i].height, 0, GL_RGB, GL_UNSIGNED_BYTE, faces[i].pixels.get());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -88,4 +101,11 @@ void Skybox::createVAO() {
 
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Skybox::deleteBuffers() {
+	glDeleteTextures(1, &_skyboxTexture);
+	glDeleteBuffers(1, &_skyboxPosVBO);
+	glDeleteVertexArrays(1, &_skyboxVAO);
+	_skyboxTexture = _skyboxPosVBO = _skyboxVAO = 0;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -10,9 +11,23 @@
 
 class Skybox {
 public:
+	// A decoded RGB face of the cube map
+	struct Face {
+		int width = 0;
+		int height = 0;
+		std::unique_ptr<unsigned char, void (*)(void*)> pixels{ nullptr, stbi_image_free };
+	};
+
+	// Decodes every face at once on a ThreadPool. Doesn't touch GL, so it can run on a worker thread while the
+	// GL thread does something else.
+	static std::vector<Face> loadFaces(std::vector<std::string> const& fileNames);
+
 	Skybox(std::vector<std::string> faces);
+	// Faces in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, as returned by loadFaces
+	Skybox(std::vector<Face> const& faces);
 
 	void createVAO();
+	void deleteBuffers();
 
 	GLuint _skyboxTexture;
 	GLuint _skyboxVAO;
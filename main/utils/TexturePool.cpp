@@ -0,0 +1,153 @@
+#include "TexturePool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "error.h"
+
+std::vector<TexturePool::Entry> TexturePool::_used;
+std::vector<TexturePool::Entry> TexturePool::_free;
+
+namespace {
+	size_t bytesPerTexel(GLenum internalFormat) {
+		switch (internalFormat) {
+		case GL_RGBA32F: return 16;
+		case GL_RGBA16F: return 8;
+		case GL_RG32F: return 8;
+		case GL_R32F: return 4;
+		case GL_R16F: return 2;
+		default: throw Error("TexturePool: unsupported internal format 0x%x", internalFormat);
+		}
+	}
+}
+
+size_t TexturePool::Entry::bytes() const {
+	return bytesPerTexel(internalFormat) * width * height * layers;
+}
+
+GLuint TexturePool::acquire(GLenum target, GLenum internalFormat, int width, int height, int layers) {
+	auto match = std::find_if(_free.begin(), _free.end(), [&](Entry const& entry) {
+		return entry.target == target && entry.internalFormat == internalFormat && entry.width == width && entry.height == height && entry.layers == layers;
+	});
+
+	if (match != _free.end()) {
+		Entry entry = *match;
+		_free.erase(match);
+		_used.push_back(entry);
+		return entry.texture;
+	}
+
+	// Throws for formats the memory statistics can't account for
+	bytesPerTexel(internalFormat);
+
+	Entry entry{ 0, target, internalFormat, width, height, layers };
+
+	// Immutable storage can't be resized or given more levels, which is why textures are only reused by exact description
+	glCreateTextures(target, 1, &entry.texture);
+	if (target == GL_TEXTURE_2D_ARRAY)
+		glTextureStorage3D(entry.texture, 1, internalFormat, width, height, layers);
+	else
+		glTextureStorage2D(entry.texture, 1, internalFormat, width, height);
+
+	_used.push_back(entry);
+	return entry.texture;
+}
+
+void TexturePool::release(GLuint texture) {
+	if (texture == 0)
+		return;
+
+	auto match = std::find_if(_used.begin(), _used.end(), [&](Entry const& entry) { return entry.texture == texture; });
+	if (match == _used.end()) {
+		glDeleteTextures(1, &texture);
+		return;
+	}
+
+	_free.push_back(*match);
+	_used.erase(match);
+
+	// Over budget, the textures released longest ago go first
+	while (getFreeBytes() > kMaxFreeBytes) {
+		glDeleteTextures(1, &_free.front().texture);
+		_free.erase(_free.begin());
+	}
+}
+
+void TexturePool::clear() {
+	for (Entry const& entry : _free)
+		glDeleteTextures(1, &entry.texture);
+
+	_free.clear();
+}
+
+size_t TexturePool::getBytes(GLuint texture) {
+	auto match = std::find_if(_used.begin(), _used.end(), [&](Entry const& entry) { return entry.texture == texture; });
+	return match != _used.end() ? match->bytes() : 0;
+}
+
+size_t TexturePool::getUsedBytes() {
+	size_t bytes = 0;
+	for (Entry const& entry : _used)
+		bytes += entry.bytes();
+	return bytes;
+}
+
+size_t TexturePool::getFreeBytes() {
+	size_t bytes = 0;
+	for (Entry const& entry : _free)
+		bytes += entry.bytes();
+	return bytes;
+}
+
+std::vector<TexturePool::FormatUsage> TexturePool::getUsageByFormat() {
+	std::vector<FormatUsage> usage;
+	for (Entry const& entry : _used) {
+		auto format = std::find_if(usage.begin(), usage.end(), [&](FormatUsage const& format) { return format.internalFormat == entry.internalFormat; });
+		if (format == usage.end())
+			usage.push_back({ entry.internalFormat, 1, entry.bytes() });
+		else {
+			format->textures++;
+			format->bytes += entry.bytes();
+		}
+	}
+	return usage;
+}
+
+char const* TexturePool::formatName(GLenum internalFormat) {
+	switch (internalFormat) {
+	case GL_RGBA32F: return "RGBA32F";
+	case GL_RGBA16F: return "RGBA16F";
+	case GL_RG32F: return "RG32F";
+	case GL_R32F: return "R32F";
+	case GL_R16F: return "R16F";
+	default: return "unknown";
+	}
+}
+
+PooledTexture::PooledTexture(GLenum target, GLenum internalFormat, int width, int height, int layers) :
+	_texture(TexturePool::acquire(target, internalFormat, width, height, layers))
+{}
+
+PooledTexture::~PooledTexture() {
+	TexturePool::release(_texture);
+}
+
+PooledTexture::PooledTexture(PooledTexture&& other) noexcept :
+	_texture(std::exchange(other._texture, 0))
+{}
+
+PooledTexture& PooledTexture::operator=(PooledTexture&& other) noexcept {
+	if (this != &other) {
+		TexturePool::release(_texture);
+		_texture = std::exchange(other._texture, 0);
+	}
+	return *this;
+}
+
+GLuint PooledTexture::id() const {
+	return _texture;
+}
+
+size_t PooledTexture::bytes() const {
+	return TexturePool::getBytes(_texture);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "glad/glad.h"
+
+// Every texture of the wave pipeline, created with immutable storage and recycled by description instead of
+// deleted and created again, so switching grid sizes back and forth reuses the storage of the previous sizes.
+// Textures are only handed out as PooledTextures, which return them when destroyed. A returned texture waits in
+// the pool until a texture of the same target, format and dimensions is acquired, or until the free textures
+// exceed kMaxFreeBytes and it's the oldest. clear() deletes the free textures before the context goes.
+class TexturePool {
+public:
+	static constexpr size_t kMaxFreeBytes = 512 * 1024 * 1024;
+
+	// Memory of the textures in use with one internal format
+	struct FormatUsage {
+		GLenum internalFormat;
+		int textures;
+		size_t bytes;
+	};
+
+	// Deletes the free textures, the ones in use belong to their PooledTextures
+	static void clear();
+
+	// Size of a texture in use, 0 for textures the pool didn't create
+	static size_t getBytes(GLuint texture);
+	static size_t getUsedBytes();
+	static size_t getFreeBytes();
+	// Textures in use grouped by internal format, in order of first use
+	static std::vector<FormatUsage> getUsageByFormat();
+
+	static char const* formatName(GLenum internalFormat);
+
+private:
+	friend class PooledTexture;
+
+	static GLuint acquire(GLenum target, GLenum internalFormat, int width, int height, int layers);
+	// Textures the pool didn't create are deleted, 0 is ignored
+	static void release(GLuint texture);
+
+	struct Entry {
+		GLuint texture;
+		GLenum target;
+		GLenum internalFormat;
+		int width;
+		int height;
+		int layers;
+
+		size_t bytes() const;
+	};
+
+	static std::vector<Entry> _used;
+	static std::vector<Entry> _free; // Oldest release first
+};
+
+// A texture from the TexturePool, returned to it when destroyed. Move only, so every texture has one owner.
+class PooledTexture {
+public:
+	PooledTexture() = default;
+	// GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY with a single level, layers is 1 for GL_TEXTURE_2D. The contents are undefined.
+	PooledTexture(GLenum target, GLenum internalFormat, int width, int height, int layers = 1);
+	~PooledTexture();
+
+	PooledTexture(PooledTexture&& other) noexcept;
+	PooledTexture& operator=(PooledTexture&& other) noexcept;
+	PooledTexture(PooledTexture const&) = delete;
+	PooledTexture& operator=(PooledTexture const&) = delete;
+
+	// 0 when empty
+	GLuint id() const;
+	size_t bytes() const;
+
+private:
+	GLuint _texture = 0;
+};
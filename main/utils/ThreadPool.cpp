@@ -0,0 +1,76 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount) {
+	if (threadCount <= 0)
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+
+	for (int i = 1; i < threadCount; i++)
+		_workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_wake.notify_all();
+
+	for (std::thread& worker : _workers)
+		worker.join();
+}
+
+void ThreadPool::parallelFor(int count, std::function<void(int)> const& task) {
+	if (_workers.empty() || count <= 1) {
+		for (int i = 0; i < count; i++)
+			task(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_task = &task;
+		_count = count;
+		_next = 0;
+		_busyWorkers = (int)_workers.size();
+		_generation++;
+	}
+	_wake.notify_all();
+
+	runTasks();
+
+	// The task and its captures live on the caller's stack, so wait for every worker to let go of it
+	std::unique_lock<std::mutex> lock(_mutex);
+	_finished.wait(lock, [this] { return _busyWorkers == 0; });
+	_task = nullptr;
+}
+
+int ThreadPool::threadCount() const {
+	return (int)_workers.size() + 1;
+}
+
+void ThreadPool::workerLoop() {
+	unsigned long long generation = 0;
+
+	while (true) {
+		std::unique_lock<std::mutex> lock(_mutex);
+		_wake.wait(lock, [&] { return _stopping || _generation != generation; });
+		if (_stopping)
+			return;
+
+		generation = _generation;
+		lock.unlock();
+
+		runTasks();
+
+		lock.lock();
+		if (--_busyWorkers == 0)
+			_finished.notify_one();
+	}
+}
+
+void ThreadPool::runTasks() {
+	for (int i = _next++; i < _count; i = _next++)
+		(*_task)(i);
+}
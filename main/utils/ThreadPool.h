@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data parallel loops. The calling thread takes part in every
+// loop, so a pool of one thread runs everything on the caller without any synchronisation.
+class ThreadPool {
+public:
+	// 0 uses every hardware thread
+	explicit ThreadPool(int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+	// Calls task(i) once for every i in [0, count), in any order and on any thread, and returns once every call has finished
+	void parallelFor(int count, std::function<void(int)> const& task);
+
+	// Including the calling thread
+	int threadCount() const;
+
+private:
+	void workerLoop();
+	void runTasks();
+
+	std::vector<std::thread> _workers;
+
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _finished;
+	bool _stopping = false;
+	unsigned long long _generation = 0; // Incremented for every loop, wakes the workers
+	int _busyWorkers = 0;
+
+	std::function<void(int)> const* _task = nullptr;
+	int _count = 0;
+	std::atomic<int> _next = 0;
+};
@@ -0,0 +1,472 @@
+#include "CpuOceanEngine.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Waves.h"
+#include "FastFourierTransform.h"
+#include "../utils/error.h"
+
+#include "CpuOceanEngineSimd.h"
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+const float PI = 3.14159274f;
+
+namespace {
+	// One float from each of several lines, the FFT runs the same butterflies on all of them
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+	constexpr int kLanes = 4;
+	struct Lanes {
+		float32x4_t v;
+
+		static Lanes load(float const* p) { return { vld1q_f32(p) }; }
+		static Lanes broadcast(float a) { return { vdupq_n_f32(a) }; }
+	};
+
+	inline void store(float* p, Lanes a) { vst1q_f32(p, a.v); }
+	inline Lanes operator+(Lanes a, Lanes b) { return { vaddq_f32(a.v, b.v) }; }
+	inline Lanes operator-(Lanes a, Lanes b) { return { vsubq_f32(a.v, b.v) }; }
+	inline Lanes operator*(Lanes a, Lanes b) { return { vmulq_f32(a.v, b.v) }; }
+#else
+	// Plain loops the compiler is free to vectorise for whatever it targets. Eight lines on x64, the batches
+	// avx2InverseTransformLines takes over when the CPU has AVX2.
+#if defined(__x86_64__) || defined(_M_X64)
+	constexpr int kLanes = 8;
+#else
+	constexpr int kLanes = 4;
+#endif
+	struct Lanes {
+		float v[kLanes];
+
+		static Lanes load(float const* p) { Lanes a; for (int i = 0; i < kLanes; i++) a.v[i] = p[i]; return a; }
+		static Lanes broadcast(float b) { Lanes a; for (int i = 0; i < kLanes; i++) a.v[i] = b; return a; }
+	};
+
+	inline void store(float* p, Lanes a) { for (int i = 0; i < kLanes; i++) p[i] = a.v[i]; }
+	inline Lanes operator+(Lanes a, Lanes b) { for (int i = 0; i < kLanes; i++) a.v[i] += b.v[i]; return a; }
+	inline Lanes operator-(Lanes a, Lanes b) { for (int i = 0; i < kLanes; i++) a.v[i] -= b.v[i]; return a; }
+	inline Lanes operator*(Lanes a, Lanes b) { for (int i = 0; i < kLanes; i++) a.v[i] *= b.v[i]; return a; }
+#endif
+
+	// Whether the CPU and OS support AVX2, checked once when an engine is created
+	bool cpuHasAvx2() {
+#if defined(__GNUC__) && defined(__x86_64__)
+		return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && defined(_M_X64)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// AVX needs the OS to save the ymm registers
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+
+		__cpuidex(info, 7, 0);
+		return osSavesYmm && (info[1] & (1 << 5));
+#else
+		return false;
+#endif
+	}
+
+	InverseTransformLines selectInverseTransformLines() {
+		if (kLanes == 8 && avx2InverseTransformLines != nullptr && cpuHasAvx2())
+			return avx2InverseTransformLines;
+
+		return inverseTransformLines<Lanes>;
+	}
+
+	// The spectrum functions of WaveSpectra.comp
+
+	// Log Gamma Function
+	// From Numerical Recipes The Art of Scientific Computing 3rd Edition - Section 6.1
+	float gammaln(float z) {
+		static const float cof[14] = { 57.1562356658629235f, -59.5979603554754912f,
+			14.1360979747417471f, -0.491913816097620199f, .339946499848118887e-4f,
+			.465236289270485756e-4f, -.983744753048795646e-4f, .158088703224912494e-3f,
+			-.210264441724104883e-3f, .217439618115212643e-3f, -.164318106536763890e-3f,
+			.844182239838527433e-4f, -.261908384015814087e-4f, .368991826595316234e-5f };
+
+		float x = z, y = z;
+		float tmp = x + 5.24218750000000000f;
+		tmp = (x + 0.5f) * std::log(tmp) - tmp;
+		float ser = 0.999999999999997092f;
+		for (int j = 0; j < 14; j++) ser += cof[j] / ++y;
+		return tmp + std::log(2.5066282746310005f * ser / x);
+	}
+
+	float dispersionRelation(float magnitude, float gravity, float depth) {
+		return std::sqrt(gravity * magnitude * std::tanh(std::min(magnitude * depth, 20.0f)));
+	}
+
+	float frequencyDerivative(float magnitude, float gravity, float depth) {
+		float th = std::tanh(std::min(magnitude * depth, 20.0f));
+		float ch = std::cosh(std::min(magnitude * depth, 10.0f));
+		return gravity * (depth * magnitude / ch / ch + th) / dispersionRelation(magnitude, gravity, depth) / 2;
+	}
+
+	float jonswap(float omega, SpectrumParameters const& spectrum) {
+		float peakOmega = spectrum.peakOmega;
+		float sigma = omega <= peakOmega ? 0.07f : 0.09f;
+
+		float r = std::exp(-(omega - peakOmega) * (omega - peakOmega) / 2 / sigma / sigma / peakOmega / peakOmega);
+		float oneOverOmega = 1 / omega;
+		float peakOmegaOverOmega = peakOmega / omega;
+		return spectrum.alpha * std::pow(spectrum.gravity, 2.0f) * std::pow(oneOverOmega, 5.0f) * std::exp(-1.25f * std::pow(peakOmegaOverOmega, 4.0f)) * std::pow(3.3f, r);
+	}
+
+	// Hasselmann shaping parameter
+	float shapingParameter(float omega, SpectrumParameters const& spectrum) {
+		float exponent = -2.33f - 1.45f * (((spectrum.windSpeed * spectrum.peakOmega) / spectrum.gravity) - 1.17f);
+
+		if (omega <= spectrum.peakOmega)
+			return 6.97f * std::pow(omega / spectrum.peakOmega, 4.06f);
+		else
+			return 9.77f * std::pow(omega / spectrum.peakOmega, exponent);
+	}
+
+	float normalisationFactor(float s) {
+		float firstTerm = std::pow(2.0f, 2 * s - 1) / PI;
+		float secondTerm = std::pow(std::exp(gammaln(s + 1)), 2.0f) / std::exp(gammaln(2 * s + 1));
+		return firstTerm * secondTerm;
+	}
+
+	float cosine2s(float theta, float s) {
+		return std::pow(std::abs(std::cos(0.5f * theta)), 2 * s);
+	}
+
+	// Hasselmann Directional Spreading
+	float directionalSpreading(float kAngle, float omega, SpectrumParameters const& spectrum) {
+		float s = shapingParameter(omega, spectrum);
+		float theta = -spectrum.windDirection / 180 * PI;
+		return normalisationFactor(s) * cosine2s(kAngle - theta, s);
+	}
+}
+
+CpuOceanEngine::CpuOceanEngine(int size, std::vector<SpectrumParameters> const& spectra, unsigned int seed, int threadCount) :
+	_size(size),
+	_cascadeCount((int)spectra.size()),
+	_halfWidth(FastFourierTransform::halfSpectrumWidth(size)),
+	_inverseTransformLines(selectInverseTransformLines()),
+	_threads(std::make_unique<ThreadPool>(threadCount))
+{
+	if (size < 8 || (size & (size - 1)) != 0)
+		throw Error("CpuOceanEngine: size %d is not a power of two of at least 8", size);
+
+	_stride = (_halfWidth + kLanes - 1) / kLanes * kLanes;
+
+	size_t texels = (size_t)size * size * _cascadeCount;
+	_displacement.assign(texels * 4, 0.0f);
+	_derivatives.assign(texels * 4, 0.0f);
+	_foam.assign(texels, 0.0f);
+
+	_h0.assign((size_t)_halfWidth * size * _cascadeCount * 4, 0.0f);
+	_waveData.assign((size_t)_halfWidth * size * _cascadeCount * 4, 0.0f);
+	_spectraReal.assign((size_t)_stride * size * _cascadeCount * FieldCount, 0.0f);
+	_spectraImaginary.assign((size_t)_stride * size * _cascadeCount * FieldCount, 0.0f);
+
+	// Twiddles in double precision so they're as accurate as a float allows
+	for (int m = 0; m < size / 2; m++) {
+		double angle = 2 * 3.14159265358979323846 * m / size;
+		_twiddlesReal.push_back((float)std::cos(angle));
+		_twiddlesImaginary.push_back((float)std::sin(angle));
+	}
+
+	int logSize = 0;
+	while ((1 << logSize) < size)
+		logSize++;
+
+	for (int i = 0; i < size; i++) {
+		int reversed = 0;
+		for (int bit = 0; bit < logSize; bit++)
+			reversed |= ((i >> bit) & 1) << (logSize - 1 - bit);
+		_bitReversal.push_back(reversed);
+	}
+
+	for (int cascade = 0; cascade < _cascadeCount; cascade++)
+		calculateInitialSpectrum(cascade, spectra[cascade], seed);
+}
+
+// WaveSpectra.comp followed by WaveSpectraConjugate.comp
+void CpuOceanEngine::calculateInitialSpectrum(int cascade, SpectrumParameters const& spectrum, unsigned int seed) {
+	int size = _size;
+	float deltaK = 2 * PI / spectrum.scale;
+	float cutoffLowSquared = spectrum.cutoffLowSquared();
+	float cutoffHighSquared = spectrum.cutoffHighSquared();
+
+	// The full spectrum centred on k = 0, as the h0k texture
+	std::vector<float> h0k((size_t)size * size * 2);
+	float* waveData = _waveData.data() + (size_t)cascade * size * _halfWidth * 4;
+
+	_threads->parallelFor(size, [&](int y) {
+		for (int x = 0; x < size; x++) {
+			int nx = x - size / 2;
+			int nz = y - size / 2;
+			float wavevectorX = nx * deltaK;
+			float wavevectorZ = nz * deltaK;
+			float magnitude = std::sqrt(wavevectorX * wavevectorX + wavevectorZ * wavevectorZ);
+
+			// Wave data is only kept for k_x >= 0
+			int halfX = (x + size / 2) % size;
+			float* data = halfX <= size / 2 ? waveData + ((size_t)y * _halfWidth + halfX) * 4 : nullptr;
+			float* result = &h0k[((size_t)y * size + x) * 2];
+
+			// The same test as WaveSpectra.comp's, so a texel on a band edge is in the same band on both
+			float radiusSquared = (float)(nx * nx + nz * nz);
+			if (radiusSquared <= cutoffHighSquared && radiusSquared >= cutoffLowSquared) {
+				float kAngle = std::atan2(wavevectorZ, wavevectorX);
+				float omega = dispersionRelation(magnitude, spectrum.gravity, spectrum.depth);
+				if (data) {
+					data[0] = wavevectorX;
+					data[1] = 1 / magnitude;
+					data[2] = wavevectorZ;
+					data[3] = omega;
+				}
+
+				float omegaDerivative = frequencyDerivative(magnitude, spectrum.gravity, spectrum.depth);
+				float directionalSpectrum = jonswap(omega, spectrum) * directionalSpreading(kAngle, omega, spectrum);
+				float amplitude = std::sqrt(2 * directionalSpectrum * std::abs(omegaDerivative) / magnitude * deltaK * deltaK);
+
+				// The noise is counter based, so every texel's is computed on its own
+				glm::vec2 noise = gaussianNoise(x, y, seed);
+				result[0] = noise.x * amplitude;
+				result[1] = noise.y * amplitude;
+			}
+			else {
+				result[0] = result[1] = 0.0f;
+				if (data) {
+					data[0] = wavevectorX;
+					data[1] = 1;
+					data[2] = wavevectorZ;
+					data[3] = 0;
+				}
+			}
+		}
+	});
+
+	// h0(k) and the conjugate of h0(-k) for the half spectrum
+	float* h0 = _h0.data() + (size_t)cascade * size * _halfWidth * 4;
+	for (int y = 0; y < size; y++) {
+		for (int j = 0; j < _halfWidth; j++) {
+			int x = (j + size / 2) % size;
+			size_t k = (size_t)y * size + x;
+			size_t minusK = (size_t)((size - y) % size) * size + (size - x) % size;
+
+			float* texel = h0 + ((size_t)y * _halfWidth + j) * 4;
+			texel[0] = h0k[k * 2 + 0];
+			texel[1] = h0k[k * 2 + 1];
+			texel[2] = h0k[minusK * 2 + 0];
+			texel[3] = -h0k[minusK * 2 + 1];
+		}
+	}
+}
+
+void CpuOceanEngine::calculateWavesAtTime(float time, float timeDelta) {
+	calculateTimeDependentSpectra(time);
+	inverseFFT();
+	assembleTextures(timeDelta);
+}
+
+// TimeDependentSpectra.comp, one task per row of a cascade
+void CpuOceanEngine::calculateTimeDependentSpectra(float time) {
+	_threads->parallelFor(_cascadeCount * _size, [&](int task) {
+		int cascade = task / _size;
+		int y = task % _size;
+
+		size_t texelOffset = ((size_t)cascade * _size + y) * _halfWidth * 4;
+		float const* h0 = _h0.data() + texelOffset;
+		float const* waveData = _waveData.data() + texelOffset;
+
+		float* real[FieldCount];
+		float* imaginary[FieldCount];
+		for (int field = 0; field < FieldCount; field++) {
+			real[field] = _spectraReal.data() + rowOffset(cascade, field, y);
+			imaginary[field] = _spectraImaginary.data() + rowOffset(cascade, field, y);
+		}
+
+		for (int j = 0; j < _halfWidth; j++) {
+			float const* h0k = h0 + j * 4;
+			float const* waveSpecifics = waveData + j * 4;
+
+			float phase = waveSpecifics[3] * time;
+			float c = std::cos(phase), s = std::sin(phase);
+			float hRe = h0k[0] * c - h0k[1] * s + h0k[2] * c + h0k[3] * s;
+			float hIm = h0k[0] * s + h0k[1] * c - h0k[2] * s + h0k[3] * c;
+
+			// i * h
+			float ihRe = -hIm, ihIm = hRe;
+
+			float kx = waveSpecifics[0], invMagnitude = waveSpecifics[1], kz = waveSpecifics[2];
+
+			// The size / 2 bins only keep the Hermitian part of terms odd in k, see TimeDependentSpectra.comp
+			float oddKx = j == _halfWidth - 1 ? 0.0f : kx;
+			float oddKz = y == 0 ? 0.0f : kz;
+
+			real[DisplacementX][j] = ihRe * oddKx * invMagnitude;
+			imaginary[DisplacementX][j] = ihIm * oddKx * invMagnitude;
+			real[DisplacementZ][j] = ihRe * oddKz * invMagnitude;
+			imaginary[DisplacementZ][j] = ihIm * oddKz * invMagnitude;
+
+			real[Elevation][j] = hRe;
+			imaginary[Elevation][j] = hIm;
+			real[DisplacementZdx][j] = -hRe * oddKx * oddKz * invMagnitude;
+			imaginary[DisplacementZdx][j] = -hIm * oddKx * oddKz * invMagnitude;
+
+			real[DisplacementYdx][j] = ihRe * oddKx;
+			imaginary[DisplacementYdx][j] = ihIm * oddKx;
+			real[DisplacementYdz][j] = ihRe * oddKz;
+			imaginary[DisplacementYdz][j] = ihIm * oddKz;
+
+			real[DisplacementXdx][j] = -hRe * kx * kx * invMagnitude;
+			imaginary[DisplacementXdx][j] = -hIm * kx * kx * invMagnitude;
+			real[DisplacementZdz][j] = -hRe * kz * kz * invMagnitude;
+			imaginary[DisplacementZdz][j] = -hIm * kz * kz * invMagnitude;
+		}
+	});
+}
+
+// FastFourierTransform::IFFT2DReal: complex transforms of the columns, then every row's half
+// spectrum is combined into the spectrum of its even + i * odd samples and transformed at half size
+void CpuOceanEngine::inverseFFT() {
+	int size = _size;
+	int halfSize = size / 2;
+	int columnBatches = _stride / kLanes;
+	int rowBatches = size / kLanes;
+
+	_threads->parallelFor(_cascadeCount * FieldCount * columnBatches, [&](int task) {
+		int field = task / columnBatches;
+		size_t offset = rowOffset(field / FieldCount, field % FieldCount, 0) + (task % columnBatches) * kLanes;
+		float* real = _spectraReal.data() + offset;
+		float* imaginary = _spectraImaginary.data() + offset;
+
+		// Adjacent columns are already interleaved, but a whole row apart, so they're copied together to stay in cache
+		thread_local std::vector<float> batchReal, batchImaginary;
+		batchReal.resize((size_t)size * kLanes);
+		batchImaginary.resize((size_t)size * kLanes);
+
+		for (int i = 0; i < size; i++) {
+			store(&batchReal[i * kLanes], Lanes::load(real + i * _stride));
+			store(&batchImaginary[i * kLanes], Lanes::load(imaginary + i * _stride));
+		}
+
+		_inverseTransformLines(batchReal.data(), batchImaginary.data(), kLanes, size,
+			_bitReversal.data(), 0, _twiddlesReal.data(), _twiddlesImaginary.data(), size);
+
+		for (int i = 0; i < size; i++) {
+			store(real + i * _stride, Lanes::load(&batchReal[i * kLanes]));
+			store(imaginary + i * _stride, Lanes::load(&batchImaginary[i * kLanes]));
+		}
+	});
+
+	_threads->parallelFor(_cascadeCount * FieldCount * rowBatches, [&](int task) {
+		int field = task / rowBatches;
+		int firstRow = (task % rowBatches) * kLanes;
+
+		// The rows are interleaved so the transform loads one element of every row at once
+		thread_local std::vector<float> batchReal, batchImaginary;
+		batchReal.resize((size_t)halfSize * kLanes);
+		batchImaginary.resize((size_t)halfSize * kLanes);
+
+		for (int lane = 0; lane < kLanes; lane++) {
+			int y = firstRow + lane;
+			size_t offset = rowOffset(field / FieldCount, field % FieldCount, y);
+			float const* rowReal = _spectraReal.data() + offset;
+			float const* rowImaginary = _spectraImaginary.data() + offset;
+
+			// The columns are centred on k = 0, which flips the sign of every other row
+			float rowSign = (y & 1) ? -1.0f : 1.0f;
+
+			for (int k = 0; k < halfSize; k++) {
+				// a = X[k], b = conj(X[halfSize - k])
+				float aRe = rowReal[k] * rowSign, aIm = rowImaginary[k] * rowSign;
+				float bRe = rowReal[halfSize - k] * rowSign, bIm = -rowImaginary[halfSize - k] * rowSign;
+
+				float differenceRe = aRe - bRe, differenceIm = aIm - bIm;
+				float oddRe = differenceRe * _twiddlesReal[k] - differenceIm * _twiddlesImaginary[k];
+				float oddIm = differenceRe * _twiddlesImaginary[k] + differenceIm * _twiddlesReal[k];
+
+				batchReal[k * kLanes + lane] = aRe + bRe - oddIm;
+				batchImaginary[k * kLanes + lane] = aIm + bIm + oddRe;
+			}
+		}
+
+		_inverseTransformLines(batchReal.data(), batchImaginary.data(), kLanes, halfSize,
+			_bitReversal.data(), 1, _twiddlesReal.data(), _twiddlesImaginary.data(), size);
+
+		for (int lane = 0; lane < kLanes; lane++) {
+			size_t offset = rowOffset(field / FieldCount, field % FieldCount, firstRow + lane);
+			float* rowReal = _spectraReal.data() + offset;
+			float* rowImaginary = _spectraImaginary.data() + offset;
+
+			for (int n = 0; n < halfSize; n++) {
+				rowReal[n] = batchReal[n * kLanes + lane];
+				rowImaginary[n] = batchImaginary[n * kLanes + lane];
+			}
+		}
+	});
+}
+
+// TextureAssembler.comp, one task per row of a cascade
+void CpuOceanEngine::assembleTextures(float timeDelta) {
+	_threads->parallelFor(_cascadeCount * _size, [&](int task) {
+		int cascade = task / _size;
+		int y = task % _size;
+
+		float const* real[FieldCount];
+		float const* imaginary[FieldCount];
+		for (int field = 0; field < FieldCount; field++) {
+			real[field] = _spectraReal.data() + rowOffset(cascade, field, y);
+			imaginary[field] = _spectraImaginary.data() + rowOffset(cascade, field, y);
+		}
+
+		// Column n of the transformed spectra holds texels 2n (real part) and 2n + 1 (imaginary part)
+		for (int x = 0; x < _size; x++) {
+			float const* const* part = (x & 1) == 0 ? real : imaginary;
+			int n = x / 2;
+
+			size_t texel = ((size_t)cascade * _size + y) * _size + x;
+
+			float* displacement = &_displacement[texel * 4];
+			displacement[0] = part[DisplacementX][n];
+			displacement[1] = part[Elevation][n];
+			displacement[2] = part[DisplacementZ][n];
+			displacement[3] = 0.0f;
+
+			float* derivatives = &_derivatives[texel * 4];
+			derivatives[0] = part[DisplacementYdx][n];
+			derivatives[1] = part[DisplacementYdz][n];
+			derivatives[2] = part[DisplacementXdx][n];
+			derivatives[3] = part[DisplacementZdz][n];
+
+			float jacobian = (1 + part[DisplacementXdx][n]) * (1 + part[DisplacementZdz][n]) - part[DisplacementZdx][n] * part[DisplacementZdx][n];
+
+			float foam = _foam[texel] + timeDelta * 0.5f / std::max(jacobian, 0.5f);
+			_foam[texel] = std::min(jacobian, foam);
+		}
+	});
+}
+
+size_t CpuOceanEngine::rowOffset(int cascade, int field, int row) const {
+	return (((size_t)cascade * FieldCount + field) * _size + row) * _stride;
+}
+
+int CpuOceanEngine::size() const {
+	return _size;
+}
+
+int CpuOceanEngine::cascadeCount() const {
+	return _cascadeCount;
+}
+
+bool CpuOceanEngine::usesAvx2() const {
+	return _inverseTransformLines == avx2InverseTransformLines;
+}
+
+int CpuOceanEngine::threadCount() const {
+	return _threads->threadCount();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "SpectrumParameters.h"
+#include "CpuOceanEngineSimd.h"
+#include "../utils/ThreadPool.h"
+
+// The wave pipeline of WaveCascadeSet evaluated on the CPU: initial spectra, time evolution, the
+// half spectrum inverse FFT and texture assembly, from the same noise and spectra. The results match
+// the GPU textures to floating point tolerance rather than bit for bit (the transcendentals and the
+// order of the FFT's sums differ), which makes it the reference to validate the GPU against and a
+// fallback where compute shaders aren't available. Against llvmpipe at 256x256 the largest error of any
+// cascade is about 1e-5 on the displacement (of about 4), 2e-6 on the derivatives and 4e-7 on the foam.
+//
+// The FFT transforms several lines at once: eight on x64, with AVX2 when the CPU has it (picked at runtime,
+// plain loops otherwise), and four with NEON or plain loops elsewhere. Every stage is split across the
+// threads of a ThreadPool.
+class CpuOceanEngine {
+public:
+	// The real fields transformed for every cascade, in the order they're packed in WaveCascadeSet's spectra layers
+	enum Field {
+		DisplacementX = 0,
+		DisplacementZ,
+		Elevation,
+		DisplacementZdx,
+		DisplacementYdx,
+		DisplacementYdz,
+		DisplacementXdx,
+		DisplacementZdz,
+		FieldCount
+	};
+
+	// seed is the Gaussian noise's, as WaveData::seed. threadCount 0 uses every hardware thread.
+	CpuOceanEngine(int size, std::vector<SpectrumParameters> const& spectra, unsigned int seed, int threadCount = 0);
+
+	void calculateWavesAtTime(float time, float timeDelta);
+
+	int size() const;
+	int cascadeCount() const;
+	int threadCount() const;
+	// Whether the FFT runs the AVX2 kernel, see CpuOceanEngineAvx2.cpp
+	bool usesAvx2() const;
+
+	// Laid out like WaveCascadeSet's texture arrays read with glGetTexImage: cascade, row, column, channel
+	std::vector<float> _displacement; // RGBA
+	std::vector<float> _derivatives; // RGBA
+	std::vector<float> _foam; // R
+
+private:
+	void calculateInitialSpectrum(int cascade, SpectrumParameters const& spectrum, unsigned int seed);
+	void calculateTimeDependentSpectra(float time);
+	void inverseFFT();
+	void assembleTextures(float timeDelta);
+
+	// First float of a row of a field's half spectrum
+	size_t rowOffset(int cascade, int field, int row) const;
+
+	int _size;
+	int _cascadeCount;
+	int _halfWidth; // Columns of a half spectrum, see FastFourierTransform::halfSpectrumWidth
+	int _stride; // Floats per row of the spectra, _halfWidth padded to whole batches of lines
+	InverseTransformLines _inverseTransformLines; // For this CPU
+
+	// Half spectra of every cascade, 4 floats per texel like the h0 and wave data textures
+	std::vector<float> _h0;
+	std::vector<float> _waveData;
+
+	// Half spectrum of every field of every cascade, real and imaginary parts stored separately.
+	// After the FFT the first _size / 2 columns hold the real field's even (real) and odd (imaginary) samples.
+	std::vector<float> _spectraReal;
+	std::vector<float> _spectraImaginary;
+
+	// e^(2 pi i m / size) for m < size / 2, and the bit reversal permutation of size elements
+	std::vector<float> _twiddlesReal;
+	std::vector<float> _twiddlesImaginary;
+	std::vector<int> _bitReversal;
+
+	std::unique_ptr<ThreadPool> _threads;
+};
@@ -0,0 +1,26 @@
+// The only file built with AVX2 enabled (see premake5.lua), so the rest of the program runs on any x64 CPU.
+// It includes nothing but the kernel and the intrinsics, so no inline function shared with other files is
+// compiled with AVX2 here.
+#include "CpuOceanEngineSimd.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+	struct Lanes {
+		__m256 v;
+
+		static Lanes load(float const* p) { return { _mm256_loadu_ps(p) }; }
+		static Lanes broadcast(float a) { return { _mm256_set1_ps(a) }; }
+	};
+
+	inline void store(float* p, Lanes a) { _mm256_storeu_ps(p, a.v); }
+	inline Lanes operator+(Lanes a, Lanes b) { return { _mm256_add_ps(a.v, b.v) }; }
+	inline Lanes operator-(Lanes a, Lanes b) { return { _mm256_sub_ps(a.v, b.v) }; }
+	inline Lanes operator*(Lanes a, Lanes b) { return { _mm256_mul_ps(a.v, b.v) }; }
+}
+
+InverseTransformLines const avx2InverseTransformLines = inverseTransformLines<Lanes>;
+#else
+InverseTransformLines const avx2InverseTransformLines = nullptr;
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+
+// The CpuOceanEngine's FFT kernel, written once for every Lanes type: a struct of one float from each of
+// several lines with static load() and broadcast(), and store(), +, - and * found next to it. Each instruction
+// set instantiates it in a translation unit of its own, compiled for that set.
+
+// Unnormalised radix-2 inverse FFT of the Lanes' worth of lines in place. Element i of the lines starts at
+// real[i * stride] and imaginary[i * stride], the twiddles are e^(2 pi i m / twiddleSize).
+// Reversing the bits of i < size takes bitReversal[i] >> bitShift.
+template <typename Lanes>
+void inverseTransformLines(float* real, float* imaginary, size_t stride, int size,
+	int const* bitReversal, int bitShift, float const* twiddlesReal, float const* twiddlesImaginary, int twiddleSize)
+{
+	for (int i = 0; i < size; i++) {
+		int j = bitReversal[i] >> bitShift;
+		if (i >= j)
+			continue;
+
+		Lanes re = Lanes::load(real + i * stride), im = Lanes::load(imaginary + i * stride);
+		store(real + i * stride, Lanes::load(real + j * stride));
+		store(imaginary + i * stride, Lanes::load(imaginary + j * stride));
+		store(real + j * stride, re);
+		store(imaginary + j * stride, im);
+	}
+
+	for (int length = 2; length <= size; length *= 2) {
+		int halfLength = length / 2;
+		int twiddleStep = twiddleSize / length;
+
+		for (int k = 0; k < halfLength; k++) {
+			Lanes wRe = Lanes::broadcast(twiddlesReal[k * twiddleStep]);
+			Lanes wIm = Lanes::broadcast(twiddlesImaginary[k * twiddleStep]);
+
+			for (int start = k; start < size; start += length) {
+				float* aRe = real + start * stride;
+				float* aIm = imaginary + start * stride;
+				float* bRe = real + (start + halfLength) * stride;
+				float* bIm = imaginary + (start + halfLength) * stride;
+
+				Lanes re = Lanes::load(aRe), im = Lanes::load(aIm);
+				Lanes otherRe = Lanes::load(bRe), otherIm = Lanes::load(bIm);
+				Lanes tRe = otherRe * wRe - otherIm * wIm;
+				Lanes tIm = otherRe * wIm + otherIm * wRe;
+
+				store(aRe, re + tRe);
+				store(aIm, im + tIm);
+				store(bRe, re - tRe);
+				store(bIm, im - tIm);
+			}
+		}
+	}
+}
+
+using InverseTransformLines = void (*)(float* real, float* imaginary, size_t stride, int size,
+	int const* bitReversal, int bitShift, float const* twiddlesReal, float const* twiddlesImaginary, int twiddleSize);
+
+// Eight lines at once with AVX2, from CpuOceanEngineAvx2.cpp. nullptr where that file isn't built with AVX2,
+// and only to be called once the CPU is known to have it.
+extern InverseTransformLines const avx2InverseTransformLines;
@@ -1,78 +1,189 @@
 #include "FastFourierTransform.h"
 
+#include <cmath>
+#include <algorithm>
+
+#include "../utils/error.h"
+
 FastFourierTransform::FastFourierTransform() {}
 
-FastFourierTransform::FastFourierTransform(int size) : _size(size) {
-	_butterfly = ComputeShader("../shaders/Butterfly.comp");
-	_fft =		 ComputeShader("../shaders/FFT.comp");
-	_permute =	 ComputeShader("../shaders/Permute.comp");
+FastFourierTransform::FastFourierTransform(int size, Mode mode) : _size(size) {
+	if (mode == Mode::SharedMemory && !supportsSharedMemory(size))
+		throw Error("Shared memory FFT doesn't support a size of %d (maximum %d)", size, kMaxSharedSize);
+
+	_useSharedMemory = mode != Mode::Butterfly && supportsSharedMemory(size);
+
+	if (_useSharedMemory) {
+		_fftShared = ComputeShader("../shaders/FFTShared.comp");
+	}
+	else {
+		_butterfly =	ComputeShader("../shaders/Butterfly.comp");
+		_fft =			ComputeShader("../shaders/FFT.comp");
+		_realSpectrum = ComputeShader("../shaders/RealSpectrum.comp");
+
+		TwiddlesAndIndices();
+	}
+}
 
-	TwiddlesAndIndices();
+bool FastFourierTransform::supportsSharedMemory(int size) {
+	return size <= kMaxSharedSize;
+}
+
+int FastFourierTransform::halfSpectrumWidth(int size) {
+	return size / 2 + 1;
 }
 
 void FastFourierTransform::TwiddlesAndIndices() {
-	int logSize = std::log2(_size);
+	_butterflyTexture = createButterflyTexture(_size);
+	_halfButterflyTexture = createButterflyTexture(_size / 2);
+}
+
+PooledTexture FastFourierTransform::createButterflyTexture(int size) {
+	int logSize = std::log2(size);
 
-	glGenTextures(1, &_butterflyTexture);
-	glBindTexture(GL_TEXTURE_2D, _butterflyTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, logSize, _size, 0, GL_RGBA, GL_FLOAT, NULL);
+	PooledTexture texture(GL_TEXTURE_2D, GL_RGBA32F, logSize, size);
 
 	glUseProgram(_butterfly._programID);
 
 	GLint sizeUniform = glGetUniformLocation(_butterfly._programID, "size");
 
-	glUniform1i(sizeUniform, _size);
+	glUniform1i(sizeUniform, size);
+
+	glBindImageTexture(0, texture.id(), 0, false, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+	glDispatchCompute(logSize, size / 8, 1);
 
-	glBindImageTexture(0, _butterflyTexture, 0, false, 0, GL_WRITE_ONLY, GL_RGBA32F);
+	return texture;
+}
+
+// Pingpong buffer with at least as many layers as the input
+void FastFourierTransform::createBuffer(int layers) {
+	if (_bufferLayers >= layers)
+		return;
+
+	_bufferTexture = PooledTexture(GL_TEXTURE_2D_ARRAY, GL_RGBA32F, _size, _size, layers);
+	_bufferLayers = layers;
+}
+
+// Complex to real inverse FFT, in place, of every layer of a GL_TEXTURE_2D_ARRAY.
+//
+// The input is halfSpectrumWidth(size) x size texels holding bins k_x = 0 to size / 2 along the rows
+// and k_z centred on 0 along the columns, the other half of a real signal's spectrum being the
+// conjugate of this one. Every texel holds the spectra of two real signals a (xy) and b (zw).
+//
+// The columns are transformed first, then the rows as complex transforms of size / 2 of the even
+// and odd samples, so the result is packed as (a[2x], a[2x + 1], b[2x], b[2x + 1]) in the first size / 2 columns.
+void FastFourierTransform::IFFT2DReal(GLuint inputTexture, int layers) {
+	if (_useSharedMemory)
+		SharedMemoryIFFT2DReal(inputTexture, layers);
+	else
+		ButterflyIFFT2DReal(inputTexture, layers);
+}
+
+void FastFourierTransform::SharedMemoryIFFT2DReal(GLuint inputTexture, int layers) {
+	int logSize = (int)std::log2(_size);
+	int columns = halfSpectrumWidth(_size);
+	int rowSize = _size / 2;
+
+	glUseProgram(_fftShared._programID);
+
+	GLint sizeUniform = glGetUniformLocation(_fftShared._programID, "size");
+	GLint logSizeUniform = glGetUniformLocation(_fftShared._programID, "logSize");
+	GLint directionUniform = glGetUniformLocation(_fftShared._programID, "direction");
+	GLint linesUniform = glGetUniformLocation(_fftShared._programID, "lines");
+	GLint lineCountUniform = glGetUniformLocation(_fftShared._programID, "lineCount");
+
+	glBindImageTexture(0, inputTexture, 0, true, 0, GL_READ_WRITE, GL_RGBA32F);
+
+	// Columns of the half spectrum first, the last work group is only partially filled
+	int lines = std::min(kMaxSharedSize / _size, columns);
+
+	glUniform1i(sizeUniform, _size);
+	glUniform1i(logSizeUniform, logSize);
+	glUniform1i(directionUniform, 1);
+	glUniform1i(linesUniform, lines);
+	glUniform1i(lineCountUniform, columns);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	glDispatchCompute((columns + lines - 1) / lines, layers, 1);
+
+	// Then the rows, as transforms of half the size
+	lines = std::min(kMaxSharedSize / rowSize, _size);
+
+	glUniform1i(sizeUniform, rowSize);
+	glUniform1i(logSizeUniform, logSize - 1);
+	glUniform1i(directionUniform, 0);
+	glUniform1i(linesUniform, lines);
+	glUniform1i(lineCountUniform, _size);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	glDispatchCompute(_size / lines, layers, 1);
 
-	glDispatchCompute(logSize, _size / 8, 1);
+	glUseProgram(0);
 }
 
-void FastFourierTransform::IFFT2D(GLuint inputTexture, GLuint bufferTexture) {
+void FastFourierTransform::ButterflyIFFT2DReal(GLuint inputTexture, int layers) {
 	int logSize = (int)std::log2(_size);
+	int columns = halfSpectrumWidth(_size);
 	int pingPong = 0;
 
+	createBuffer(layers);
+
 	glUseProgram(_fft._programID);
 
-	GLint pingPongUniform = glGetUniformLocation(_fft._programID, "pingpong");
-	GLint stepUniform = glGetUniformLocation(_fft._programID, "iteration");
-	GLint directionUniform = glGetUniformLocation(_fft._programID, "direction");
+	GLint layersUniform = glGetUniformLocation(_fft._programID, "layers");
 
-	glBindImageTexture(0, _butterflyTexture, 0, false, 0, GL_READ_ONLY, GL_RGBA32F);
-	glBindImageTexture(1, inputTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(2, bufferTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
+	glUniform1i(layersUniform, layers);
 
-	for (int i = 0; i < logSize; i++) {
-		pingPong++;
-		pingPong %= 2;
+	glBindImageTexture(1, inputTexture, 0, true, 0, GL_READ_WRITE, GL_RGBA32F);
+	glBindImageTexture(2, _bufferTexture.id(), 0, true, 0, GL_READ_WRITE, GL_RGBA32F);
 
-		glUniform1i(pingPongUniform, pingPong);
-		glUniform1i(stepUniform, i);
-		glUniform1i(directionUniform, 0);
+	ButterflyStages(_butterflyTexture.id(), 1, logSize, pingPong, (columns + 7) / 8, _size / 8);
 
-		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-		glDispatchCompute(_size / 8, _size / 8, 1);
-	}
+	// Combining bins k and size / 2 - k needs both, so it's done out of place into the buffer the
+	// row stages then start from. With 2 * logSize - 1 stages in total that always swaps buffers,
+	// and the row stages end in the input texture.
+	GLuint source = pingPong == 0 ? inputTexture : _bufferTexture.id();
+	GLuint destination = pingPong == 0 ? _bufferTexture.id() : inputTexture;
+
+	glUseProgram(_realSpectrum._programID);
+
+	GLint sizeUniform = glGetUniformLocation(_realSpectrum._programID, "size");
+
+	glUniform1i(sizeUniform, _size);
+
+	glBindImageTexture(0, source, 0, true, 0, GL_READ_ONLY, GL_RGBA32F);
+	glBindImageTexture(1, destination, 0, true, 0, GL_WRITE_ONLY, GL_RGBA32F);
 
-	glBindImageTexture(0, _butterflyTexture, 0, false, 0, GL_READ_ONLY, GL_RGBA32F);
-	glBindImageTexture(1, inputTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(2, bufferTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	glDispatchCompute(_size / 32 + 1, _size / 8, layers);
+	pingPong = 1 - pingPong;
 
-	for (int i = 0; i < logSize; i++) {
+	glUseProgram(_fft._programID);
+
+	glBindImageTexture(1, inputTexture, 0, true, 0, GL_READ_WRITE, GL_RGBA32F);
+	glBindImageTexture(2, _bufferTexture.id(), 0, true, 0, GL_READ_WRITE, GL_RGBA32F);
+
+	ButterflyStages(_halfButterflyTexture.id(), 0, logSize - 1, pingPong, _size / 16, _size / 8);
+
+	glUseProgram(0);
+}
+
+// Runs the stages of one axis with the FFT.comp program in use, pingPong is 1 when the last stage wrote to the buffer
+void FastFourierTransform::ButterflyStages(GLuint butterflyTexture, int direction, int stages, int& pingPong, int groupsX, int groupsY) {
+	GLint pingPongUniform = glGetUniformLocation(_fft._programID, "pingpong");
+	GLint stepUniform = glGetUniformLocation(_fft._programID, "iteration");
+	GLint directionUniform = glGetUniformLocation(_fft._programID, "direction");
+
+	glBindImageTexture(0, butterflyTexture, 0, false, 0, GL_READ_ONLY, GL_RGBA32F);
+
+	for (int i = 0; i < stages; i++) {
 		pingPong++;
 		pingPong %= 2;
 
 		glUniform1i(pingPongUniform, pingPong);
 		glUniform1i(stepUniform, i);
-		glUniform1i(directionUniform, 1);
+		glUniform1i(directionUniform, direction);
 
-		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-		glDispatchCompute(_size / 8, _size / 8, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		glDispatchCompute(groupsX, groupsY, 1);
 	}
-
-	glUseProgram(_permute._programID);
-	glBindImageTexture(0, inputTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-	glDispatchCompute(_size / 8, _size / 8, 1);
-	glUseProgram(0);
 }
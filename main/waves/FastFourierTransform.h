@@ -1,20 +1,49 @@
 #pragma once
 
 #include "../shaders/ComputeShader.h"
+#include "../utils/TexturePool.h"
 
+// Move only, the programs and textures are released when it's destroyed
 class FastFourierTransform {
 public:
+	// Largest size the shared memory kernel (FFTShared.comp) can transform, larger sizes use the butterfly texture
+	static constexpr int kMaxSharedSize = 1024;
+
+	enum class Mode {
+		Auto,			// Shared memory when the size allows it, otherwise butterfly texture
+		SharedMemory,	// One dispatch per axis, every stage runs in shared memory
+		Butterfly		// One dispatch per stage, indices and twiddles from the butterfly texture
+	};
+
 	FastFourierTransform();
-	FastFourierTransform(int size);
+	FastFourierTransform(int size, Mode mode = Mode::Auto);
+
+	static bool supportsSharedMemory(int size);
+	// Width of a half spectrum texture, bins k_x = 0 to size / 2
+	static int halfSpectrumWidth(int size);
 
 	void TwiddlesAndIndices();
-	void IFFT2D(GLuint inputTexture, GLuint bufferTexture);
+	// Inverse FFT of half spectra, see FastFourierTransform.cpp for the layout
+	void IFFT2DReal(GLuint inputTexture, int layers);
 
 	ComputeShader _butterfly;
 	ComputeShader _fft;
-	ComputeShader _permute;
+	ComputeShader _realSpectrum;
+	ComputeShader _fftShared;
 
-	GLuint _butterflyTexture;
+	PooledTexture _butterflyTexture;
+	PooledTexture _halfButterflyTexture; // Twiddles and indices of the size / 2 row transforms of IFFT2DReal
+	PooledTexture _bufferTexture; // Pingpong texture array for the butterfly path, created on first use
+	int _bufferLayers = 0;
 
 	int _size;
-};
\ No newline at end of file
+	bool _useSharedMemory = false;
+
+private:
+	PooledTexture createButterflyTexture(int size);
+	void createBuffer(int layers);
+
+	void SharedMemoryIFFT2DReal(GLuint inputTexture, int layers);
+	void ButterflyIFFT2DReal(GLuint inputTexture, int layers);
+	void ButterflyStages(GLuint butterflyTexture, int direction, int stages, int& pingPong, int groupsX, int groupsY);
+};
@@ -0,0 +1,140 @@
+#include "HeightReadback.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+HeightReadback::~HeightReadback() {
+	release();
+}
+
+void HeightReadback::capture(WaveCascadeSet const& waves) {
+	if (waves.size() != _size || waves.cascadeCount() != _cascadeCount)
+		allocate(waves.size(), waves.cascadeCount());
+
+	_frame++;
+
+	// Copies finish in order, but more than one can have finished since the last call
+	int newest = -1;
+	for (int i = 0; i < kRingSize; i++) {
+		Slot& slot = _slots[i];
+		if (slot.fence == nullptr || glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			continue;
+
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+		if (newest == -1 || slot.frame > _slots[newest].frame)
+			newest = i;
+	}
+
+	if (newest != -1) {
+		std::unique_lock<std::shared_mutex> lock(_mutex);
+		_published = newest;
+	}
+
+	int free = -1;
+	for (int i = 0; i < kRingSize && free == -1; i++) {
+		if (_slots[i].fence == nullptr && i != _published)
+			free = i;
+	}
+	if (free == -1)
+		return;
+
+	Slot& slot = _slots[free];
+	for (int i = 0; i < _cascadeCount; i++)
+		slot.scales[i] = (float)waves._cascades[i]._spectrum.scale;
+	slot.frame = _frame;
+
+	size_t slotBytes = (size_t)_size * _size * _cascadeCount * sizeof(float);
+
+	// The displacement was written with image stores, and only its y channel is needed
+	glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, _buffer);
+	glGetTextureImage(waves._displacementTexture.id(), 0, GL_GREEN, GL_FLOAT, (GLsizei)slotBytes, (void*)(free * slotBytes));
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// The flush makes sure the fence reaches the GPU even if nothing else is submitted before the next poll
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+}
+
+float HeightReadback::sampleHeight(float x, float z) const {
+	std::shared_lock<std::shared_mutex> lock(_mutex);
+	if (_published == -1)
+		return 0.0f;
+
+	Slot const& slot = _slots[_published];
+	float const* data = slotData(_published);
+	float const size = (float)_size;
+
+	float height = 0.0f;
+	for (int cascade = 0; cascade < _cascadeCount; cascade++) {
+		float const* layer = data + (size_t)cascade * _size * _size;
+
+		// Texel centres are at (i + 0.5) / size, and the texture repeats
+		float u = x / slot.scales[cascade] * size - 0.5f;
+		float v = z / slot.scales[cascade] * size - 0.5f;
+		u -= size * std::floor(u / size);
+		v -= size * std::floor(v / size);
+
+		int x0 = std::min((int)u, _size - 1);
+		int z0 = std::min((int)v, _size - 1);
+		int x1 = (x0 + 1) % _size;
+		int z1 = (z0 + 1) % _size;
+		float tx = u - x0;
+		float tz = v - z0;
+
+		float top = layer[z0 * _size + x0] * (1 - tx) + layer[z0 * _size + x1] * tx;
+		float bottom = layer[z1 * _size + x0] * (1 - tx) + layer[z1 * _size + x1] * tx;
+		height += top * (1 - tz) + bottom * tz;
+	}
+
+	return height;
+}
+
+int HeightReadback::getLatency() const {
+	if (_published == -1)
+		return -1;
+
+	return (int)(_frame - _slots[_published].frame);
+}
+
+void HeightReadback::release() {
+	for (Slot& slot : _slots) {
+		if (slot.fence != nullptr)
+			glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+	}
+
+	std::unique_lock<std::shared_mutex> lock(_mutex);
+	_published = -1;
+
+	if (_buffer != 0) {
+		glUnmapNamedBuffer(_buffer);
+		glDeleteBuffers(1, &_buffer);
+	}
+	_buffer = 0;
+	_mapped = nullptr;
+	_size = _cascadeCount = 0;
+}
+
+void HeightReadback::allocate(int size, int cascadeCount) {
+	release();
+
+	std::unique_lock<std::shared_mutex> lock(_mutex);
+	_size = size;
+	_cascadeCount = cascadeCount;
+	for (Slot& slot : _slots)
+		slot.scales.assign(cascadeCount, 1.0f);
+
+	// Coherent, so a signalled fence is all it takes for the copy to be visible through the mapping
+	GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr bytes = (GLsizeiptr)size * size * cascadeCount * sizeof(float) * kRingSize;
+	glCreateBuffers(1, &_buffer);
+	glNamedBufferStorage(_buffer, bytes, nullptr, flags);
+	_mapped = (float*)glMapNamedBufferRange(_buffer, 0, bytes, flags);
+}
+
+float const* HeightReadback::slotData(int slot) const {
+	return _mapped + (size_t)slot * _size * _size * _cascadeCount;
+}
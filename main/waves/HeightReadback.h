@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <shared_mutex>
+#include <vector>
+
+#include "glad/glad.h"
+
+#include "WaveCascadeSet.h"
+
+// Streams the vertical displacement of every cascade back to the CPU for code that needs the ocean's height
+// without a GL context, e.g. buoyancy or spawn positions. Each frame the displacement texture is copied into a
+// slot of a persistently mapped ring of pixel pack buffers, fenced, and published once the GPU has finished it,
+// so the heights are one or two frames old and the GL thread never waits for the copy.
+//
+// capture(), getLatency() and release() belong to the GL thread; sampleHeight() can be called from any thread.
+class HeightReadback {
+public:
+	// One slot is published, the others can be in flight
+	static constexpr int kRingSize = 3;
+
+	HeightReadback() = default;
+	~HeightReadback();
+
+	HeightReadback(HeightReadback const&) = delete;
+	HeightReadback& operator=(HeightReadback const&) = delete;
+
+	// Publishes the newest finished copy, then copies this frame's displacement into a free slot. When every other
+	// slot is still in flight the frame is skipped rather than waited for. Reallocates when the grid size changes.
+	void capture(WaveCascadeSet const& waves);
+
+	// Height of the ocean at world position (x, z), the sum of every cascade's vertical displacement filtered
+	// bilinearly, the way PBR.vert places the grid. The horizontal displacement isn't followed, so on steep choppy
+	// waves this is the height of a point that has moved slightly. 0 until the first copy has been published.
+	float sampleHeight(float x, float z) const;
+
+	// Frames between the published heights and the latest capture() call, -1 before the first is published
+	int getLatency() const;
+
+	void release();
+
+private:
+	struct Slot {
+		GLsync fence = nullptr; // Set while the copy is in flight
+		unsigned long long frame = 0; // capture() call the copy was made in
+		std::vector<float> scales; // Of every cascade when the copy was made, in world units per texture repeat
+	};
+
+	void allocate(int size, int cascadeCount);
+	float const* slotData(int slot) const;
+
+	GLuint _buffer = 0;
+	float* _mapped = nullptr;
+	int _size = 0;
+	int _cascadeCount = 0;
+
+	std::array<Slot, kRingSize> _slots;
+	int _published = -1;
+	unsigned long long _frame = 0;
+
+	// Held exclusively only to change or free the published slot
+	mutable std::shared_mutex _mutex;
+};
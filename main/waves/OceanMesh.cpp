@@ -1,66 +1,590 @@
 #include "OceanMesh.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "../utils/GpuProfiler.h"
+
 Mesh OceanMesh::_mesh = Mesh();
+GLsizei OceanMesh::_indexCount = 0;
+std::vector<glm::vec2> OceanMesh::_morphRanges;
 GLuint OceanMesh::_posVBO = 0;
 GLuint OceanMesh::_indicesEBO = 0;
 GLuint OceanMesh::_meshVAO = 0;
+GLuint OceanMesh::_tilesVBO = 0;
+std::vector<ClipmapTile> OceanMesh::_tiles;
+std::vector<DrawElementsIndirectCommand> OceanMesh::_commands;
+std::vector<glm::vec4> OceanMesh::_tileBounds;
+GLuint OceanMesh::_commandsBuffer = 0;
+GLuint OceanMesh::_tileBoundsBuffer = 0;
+ComputeShader OceanMesh::_tileCulling;
+ComputeShader OceanMesh::_tiledInstances;
+glm::vec3 OceanMesh::_cameraPosition = glm::vec3(0);
+bool OceanMesh::_frustumCulling = true;
+std::atomic<bool> OceanMesh::_cacheOptimisedIndices = true;
 int OceanMesh::_width = 0;
 int OceanMesh::_height = 0;
+MeshMode OceanMesh::_mode = MeshMode::VertexPulling;
+bool OceanMesh::_staging = false;
+std::future<MeshData> OceanMesh::_stagedGeneration;
+MeshData OceanMesh::_staged;
+GLuint OceanMesh::_stagedIndicesEBO = 0;
+GLuint OceanMesh::_stagedPosVBO = 0;
+size_t OceanMesh::_stagedUploaded = 0;
+
+namespace {
+	// Two triangles of the quad at column x and row z of a grid width vertices across
+	void appendQuad(std::vector<unsigned short>& indices, int width, int x, int z) {
+		indices.push_back(z * width + x);
+		indices.push_back((z + 1) * width + x);
+		indices.push_back((z + 1) * width + (x + 1));
+
+		indices.push_back(z * width + x);
+		indices.push_back((z + 1) * width + (x + 1));
+		indices.push_back(z * width + (x + 1));
+	}
+
+	// Every quad of a grid quadsX by quadsZ quads, vertices numbered row by row. The rows are emitted a strip of
+	// stripWidth columns at a time, short enough that a row's vertices are still in the post-transform cache when the
+	// next row reuses them. A full width strip is the plain row by row order.
+	void appendGrid(std::vector<unsigned short>& indices, int quadsX, int quadsZ, int stripWidth) {
+		for (int stripX = 0; stripX < quadsX; stripX += stripWidth) {
+			int endX = std::min(stripX + stripWidth, quadsX);
+			for (int z = 0; z < quadsZ; z++) {
+				for (int x = stripX; x < endX; x++)
+					appendQuad(indices, quadsX + 1, x, z);
+			}
+		}
+	}
+
+	// Vertex shader invocations per triangle of a FIFO post-transform cache of cacheSize entries, 0.5 at best for a grid
+	float fifoCacheMissRatio(std::vector<unsigned int> const& indices, int cacheSize) {
+		std::vector<unsigned int> cache(cacheSize, std::numeric_limits<unsigned int>::max());
+		int oldest = 0;
+		int misses = 0;
+
+		for (unsigned int index : indices) {
+			if (std::find(cache.begin(), cache.end(), index) != cache.end())
+				continue;
 
-void OceanMesh::initialiseMesh(int size) {
-	createPlaneMesh(size, size);
+			cache[oldest] = index;
+			oldest = (oldest + 1) % cacheSize;
+			misses++;
+		}
+
+		return indices.empty() ? 0.0f : misses / (indices.size() / 3.0f);
+	}
+
+	// Candidate Tiled instances along each side of the square around the camera, enough to reach the draw distance
+	int tiledTilesAcross() {
+		return 2 * (int)std::ceil(OceanMesh::kTiledDrawDistance / OceanMesh::kTiledTileSize) + 1;
+	}
 }
 
-void OceanMesh::createPlaneMesh(int width, int height) {
-	_mesh = Mesh();
-	_width = width;
-	_height = height;
-
-	for (int z = 0; z < height; z++) {
-		for (int x = 0; x < width; x++) {
-			// Markus says we don't actually need to pass positions in to the gpu, but rather can use VertexID in the vertex shader
-			// for positions, but since i've got it to work how it is, ill leave it for now
-			_mesh.positions.push_back(glm::vec3(x, 0, z));
+void OceanMesh::initialiseMesh(int size, MeshMode mode) {
+	setMesh(generateMesh(size, mode));
+}
+
+MeshData OceanMesh::generateMesh(int size, MeshMode mode) {
+	MeshData data;
+	data.mode = mode;
+
+	// Computed once here so the render loop can pass them straight to glUniform2fv
+	if (mode == MeshMode::Clipmap) {
+		for (int level = 0; level < kClipmapLevels; level++)
+			data.morphRanges.push_back(glm::vec2(kClipmapMorphStart, 1.0f) * kClipmapBaseRange * std::ldexp(1.0f, level));
+	}
+	else if (mode == MeshMode::Tiled) {
+		for (int level = 0; level < kTiledLevels; level++)
+			data.morphRanges.push_back(glm::vec2(kClipmapMorphStart, 1.0f) * kTiledBaseRange * std::ldexp(1.0f, level));
+	}
+
+	// The clipmap draws one small tile many times instead of a size x size grid
+	if (mode == MeshMode::Clipmap) {
+		createPlaneMesh(data, kClipmapTileSize + 1, kClipmapTileSize + 1);
+	}
+	else if (mode == MeshMode::Tessellation) {
+		// Patches across the grid rather than vertices, PBR.vert places their corners
+		data.width = data.height = std::max(size / kPatchSize, 1);
+	}
+	else if (mode == MeshMode::Tiled) {
+		// Every level's grid in one index buffer, each with a draw command and a range of instances filled on the GPU by cull
+		data.width = data.height = kTiledTileSize + 1;
+
+		GLuint capacity = (GLuint)(tiledTilesAcross() * tiledTilesAcross());
+		for (int level = 0; level < kTiledLevels; level++) {
+			int quads = kTiledTileSize >> level;
+			GLuint firstIndex = (GLuint)data.mesh.indices.size();
+			appendGrid(data.mesh.indices, quads, quads, _cacheOptimisedIndices ? kCacheStripWidth : quads);
+
+			data.commands.push_back({ (GLuint)data.mesh.indices.size() - firstIndex, 0, firstIndex, 0, level * capacity });
 		}
 	}
+	else {
+		createPlaneMesh(data, size, size);
+	}
+
+	return data;
+}
+
+void OceanMesh::setMesh(MeshData data) {
+	_mode = data.mode;
+	_width = data.width;
+	_height = data.height;
+	_mesh = std::move(data.mesh);
+	_commands = std::move(data.commands);
+	_tileBounds = std::move(data.tileBounds);
+	_morphRanges = std::move(data.morphRanges);
+	_tiles.clear();
+}
 
-	for (int z = 0; z < height - 1; z++) {
-		for (int x = 0; x < width - 1; x++) {
-			_mesh.indices.push_back(z * width + x);
-			_mesh.indices.push_back((z + 1) * width + x);
-			_mesh.indices.push_back((z + 1) * width + (x + 1));
+void OceanMesh::createPlaneMesh(MeshData& data, int width, int height) {
+	data.width = width;
+	data.height = height;
 
-			_mesh.indices.push_back(z * width + x);
-			_mesh.indices.push_back((z + 1) * width + (x + 1));
-			_mesh.indices.push_back(z * width + (x + 1));
+	// The vertex shader generates the same grid itself
+	if (data.mode == MeshMode::VertexPulling)
+		return;
+
+	// Quads are stored culling tile by culling tile, so each tile is one contiguous range of indices with its own draw
+	// command. A tile has its own vertices too, numbered from its command's base vertex, so 16 bit indices cover any grid.
+	Mesh& mesh = data.mesh;
+	for (int tileZ = 0; tileZ < height - 1; tileZ += kCullingTileSize) {
+		for (int tileX = 0; tileX < width - 1; tileX += kCullingTileSize) {
+			int endX = std::min(tileX + kCullingTileSize, width - 1);
+			int endZ = std::min(tileZ + kCullingTileSize, height - 1);
+			GLuint firstIndex = (GLuint)mesh.indices.size();
+			GLint baseVertex = (GLint)mesh.positions.size();
+
+			// Clipmap tiles only need indices, PBR.vert places their vertices
+			if (data.mode == MeshMode::Indexed) {
+				for (int z = tileZ; z <= endZ; z++) {
+					for (int x = tileX; x <= endX; x++)
+						mesh.positions.push_back(glm::vec3(x, 0, z));
+				}
+			}
+
+			int quadsX = endX - tileX;
+			appendGrid(mesh.indices, quadsX, endZ - tileZ, _cacheOptimisedIndices ? kCacheStripWidth : quadsX);
+
+			data.commands.push_back({ (GLuint)mesh.indices.size() - firstIndex, 1, firstIndex, baseVertex, 0 });
+			data.tileBounds.push_back(glm::vec4(tileX, tileZ, endX, endZ));
 		}
 	}
 }
 
 void OceanMesh::createVAO() {
+	// A core profile draw needs a VAO bound, even one without attributes
 	glGenVertexArrays(1, &_meshVAO);
 	glBindVertexArray(_meshVAO);
 
-	glGenBuffers(1, &_posVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, _posVBO);
-	glBufferData(GL_ARRAY_BUFFER, _mesh.positions.size() * sizeof(glm::vec3), _mesh.positions.data(), GL_STATIC_DRAW);
+	if (_mode == MeshMode::VertexPulling || _mode == MeshMode::Tessellation) {
+		glBindVertexArray(0);
+		return;
+	}
 
-	glGenBuffers(1, &_indicesEBO);
+	// A grid swapped in by swapStaged has its buffers uploaded already
+	if (_indicesEBO == 0) {
+		glCreateBuffers(1, &_indicesEBO);
+		glNamedBufferData(_indicesEBO, _mesh.indices.size() * sizeof(unsigned short), _mesh.indices.data(), GL_STATIC_DRAW);
+		_indexCount = (GLsizei)_mesh.indices.size();
+	}
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indicesEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, _mesh.indices.size() * sizeof(unsigned int), _mesh.indices.data(), GL_STATIC_DRAW);
 
-	glBindBuffer(GL_ARRAY_BUFFER, _posVBO);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0);
+	if (_mode == MeshMode::Indexed) {
+		if (_posVBO == 0) {
+			glCreateBuffers(1, &_posVBO);
+			glNamedBufferData(_posVBO, _mesh.positions.size() * sizeof(glm::vec3), _mesh.positions.data(), GL_STATIC_DRAW);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, _posVBO);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0);
+	}
+
+	// Nothing reads the grid on the CPU once it's uploaded, so only its size is kept
+	_mesh = Mesh();
+
+	glGenBuffers(1, &_commandsBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commandsBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, _commands.size() * sizeof(DrawElementsIndirectCommand), _commands.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	if (_mode == MeshMode::Tiled) {
+		// Written by TiledInstances.comp as a storage buffer and read by the draw as per-instance attributes
+		_tiledInstances = ComputeShader("../shaders/TiledInstances.comp");
+
+		glGenBuffers(1, &_tilesVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, _tilesVBO);
+		glBufferData(GL_ARRAY_BUFFER, kTiledLevels * getTiledCandidateCount() * sizeof(ClipmapTile), nullptr, GL_DYNAMIC_DRAW);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ClipmapTile), 0);
+		glVertexAttribDivisor(1, 1);
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+
+	// Indirect commands and tile bounds for culling, refilled by update every frame for the clipmap
+	_tileCulling = ComputeShader("../shaders/TileCulling.comp");
+
+	glGenBuffers(1, &_tileBoundsBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _tileBoundsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, _tileBounds.size() * sizeof(glm::vec4), _tileBounds.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	if (_mode == MeshMode::Clipmap) {
+		// Refilled by update every frame
+		glGenBuffers(1, &_tilesVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, _tilesVBO);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ClipmapTile), 0);
+		glVertexAttribDivisor(1, 1);
+	}
 
 	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+namespace {
+	float clipmapRange(int level) {
+		return OceanMesh::kClipmapBaseRange * std::ldexp(1.0f, level);
+	}
+
+	float clipmapNodeSize(int level) {
+		return OceanMesh::kClipmapTileSize * std::ldexp(1.0f, level);
+	}
+
+	// From the camera to the closest point of a square on the water plane
+	float distanceToNode(glm::vec3 camera, glm::vec2 origin, float size) {
+		glm::vec2 closest = glm::clamp(glm::vec2(camera.x, camera.z), origin, origin + size);
+		return glm::length(glm::vec3(closest.x - camera.x, camera.y, closest.y - camera.z));
+	}
+
+	// Quadtree descent: a node is drawn as a tile of its own level once all of it is beyond the next finer
+	// level's range, so a tile only ever borders tiles of its own level or of the levels either side.
+	void selectNode(glm::vec3 camera, glm::vec2 origin, int level, std::vector<ClipmapTile>& tiles) {
+		float size = clipmapNodeSize(level);
+
+		if (level == 0 || distanceToNode(camera, origin, size) > clipmapRange(level - 1)) {
+			tiles.push_back({ origin, size / OceanMesh::kClipmapTileSize, (float)level });
+			return;
+		}
+
+		float half = size / 2;
+		selectNode(camera, origin, level - 1, tiles);
+		selectNode(camera, origin + glm::vec2(half, 0), level - 1, tiles);
+		selectNode(camera, origin + glm::vec2(0, half), level - 1, tiles);
+		selectNode(camera, origin + glm::vec2(half, half), level - 1, tiles);
+	}
+}
+
+void OceanMesh::update(glm::vec3 cameraPosition) {
+	_cameraPosition = cameraPosition;
+	if (_mode != MeshMode::Clipmap)
+		return;
+
+	_tiles.clear();
+
+	// Nodes of the coarsest level are world aligned, which keeps every level's vertices snapped to its own
+	// spacing as the camera moves, so the surface doesn't swim
+	int top = kClipmapLevels - 1;
+	float size = clipmapNodeSize(top);
+	float reach = clipmapRange(top);
+
+	glm::vec2 first = glm::floor((glm::vec2(cameraPosition.x, cameraPosition.z) - reach) / size);
+	glm::vec2 last = glm::floor((glm::vec2(cameraPosition.x, cameraPosition.z) + reach) / size);
+
+	for (float z = first.y; z <= last.y; z++) {
+		for (float x = first.x; x <= last.x; x++) {
+			glm::vec2 origin = glm::vec2(x, z) * size;
+			if (distanceToNode(cameraPosition, origin, size) <= reach)
+				selectNode(cameraPosition, origin, top, _tiles);
+		}
+	}
+
+	// Tile i is instance i, one command each so culling can drop any of them
+	_commands.clear();
+	_tileBounds.clear();
+	for (GLuint i = 0; i < (GLuint)_tiles.size(); i++) {
+		float extent = _tiles[i].spacing * kClipmapTileSize;
+		_commands.push_back({ (GLuint)_indexCount, 1, 0, 0, i });
+		_tileBounds.push_back(glm::vec4(_tiles[i].origin, _tiles[i].origin + extent));
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, _tilesVBO);
+	glBufferData(GL_ARRAY_BUFFER, _tiles.size() * sizeof(ClipmapTile), _tiles.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (_frustumCulling) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commandsBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, _commands.size() * sizeof(DrawElementsIndirectCommand), _commands.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _tileBoundsBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, _tileBounds.size() * sizeof(glm::vec4), _tileBounds.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+}
+
+void OceanMesh::cull(glm::mat4 viewProjection, GLuint displacementBounds, int cascadeCount) {
+	if (_mode == MeshMode::Tiled) {
+		cullTiles(viewProjection, displacementBounds, cascadeCount);
+		return;
+	}
+
+	if (_commands.empty())
+		return;
+
+	// The Indexed grid is always drawn through its commands, so put back the instance counts an earlier cull may have zeroed
+	if (!_frustumCulling) {
+		if (_mode == MeshMode::Indexed)
+			glNamedBufferSubData(_commandsBuffer, 0, _commands.size() * sizeof(DrawElementsIndirectCommand), _commands.data());
+		return;
+	}
+
+	GpuProfiler::Scope scope("TileCulling");
+
+	glUseProgram(_tileCulling._programID);
+
+	glUniformMatrix4fv(glGetUniformLocation(_tileCulling._programID, "viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+	glUniform1ui(glGetUniformLocation(_tileCulling._programID, "tileCount"), (GLuint)_commands.size());
+	glUniform1i(glGetUniformLocation(_tileCulling._programID, "cascadeCount"), cascadeCount);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _commandsBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _tileBoundsBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, displacementBounds);
+
+	glDispatchCompute(((GLuint)_commands.size() + 63) / 64, 1, 1);
+
+	// The draw reads the instance counts as indirect commands
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+	glUseProgram(0);
+}
+
+void OceanMesh::cullTiles(glm::mat4 viewProjection, GLuint displacementBounds, int cascadeCount) {
+	GpuProfiler::Scope scope("TiledInstances");
+
+	// Every level starts the frame empty, the compute shader appends the instances it keeps
+	glNamedBufferSubData(_commandsBuffer, 0, _commands.size() * sizeof(DrawElementsIndirectCommand), _commands.data());
+
+	GLuint program = _tiledInstances._programID;
+	glUseProgram(program);
+
+	int tilesAcross = tiledTilesAcross();
+	glUniformMatrix4fv(glGetUniformLocation(program, "viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+	glUniform3fv(glGetUniformLocation(program, "cameraPosition"), 1, glm::value_ptr(_cameraPosition));
+	glUniform1i(glGetUniformLocation(program, "frustumCulling"), _frustumCulling);
+	glUniform1i(glGetUniformLocation(program, "cascadeCount"), cascadeCount);
+	glUniform1i(glGetUniformLocation(program, "tilesAcross"), tilesAcross);
+	glUniform1f(glGetUniformLocation(program, "tileExtent"), (float)kTiledTileSize);
+	glUniform1f(glGetUniformLocation(program, "drawDistance"), kTiledDrawDistance);
+	glUniform1f(glGetUniformLocation(program, "baseRange"), kTiledBaseRange);
+	glUniform1i(glGetUniformLocation(program, "levelCount"), kTiledLevels);
+	glUniform1ui(glGetUniformLocation(program, "capacity"), (GLuint)getTiledCandidateCount());
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _commandsBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _tilesVBO);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, displacementBounds);
+
+	glDispatchCompute((GLuint)(tilesAcross * tilesAcross + 63) / 64, 1, 1);
+
+	// The draw reads the instance counts as indirect commands and the instances as vertex attributes
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	glUseProgram(0);
+}
+
+void OceanMesh::draw() {
+	glBindVertexArray(_meshVAO);
+
+	if (_mode == MeshMode::VertexPulling) {
+		// One triangle strip along z per column of quads, the same triangles and winding as the indexed mesh (see PBR.vert)
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 2 * _height, _width - 1);
+	}
+	else if (_mode == MeshMode::Indexed || _mode == MeshMode::Tiled || (_frustumCulling && !_commands.empty())) {
+		// Every tile in one call with the instance counts set by cull. The Indexed grid's tiles each have their own base
+		// vertex and Tiled has a command per level, so both are always drawn this way.
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commandsBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, nullptr, (GLsizei)_commands.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	else if (_mode == MeshMode::Clipmap) {
+		glDrawElementsInstanced(GL_TRIANGLES, _indexCount, GL_UNSIGNED_SHORT, 0, (GLsizei)_tiles.size());
+	}
+	else if (_mode == MeshMode::Tessellation) {
+		glPatchParameteri(GL_PATCH_VERTICES, 4);
+		glDrawArrays(GL_PATCHES, 0, 4 * getPatchCount());
+	}
+
+	glBindVertexArray(0);
+}
+
+void OceanMesh::deleteBuffers() {
+	discardStaged();
+	deleteGridBuffers();
+
+	_tileCulling.deleteProgram();
+	_tiledInstances.deleteProgram();
+}
+
+void OceanMesh::deleteGridBuffers() {
+	glDeleteBuffers(1, &_posVBO);
+	glDeleteBuffers(1, &_indicesEBO);
+	glDeleteBuffers(1, &_tilesVBO);
+	glDeleteBuffers(1, &_commandsBuffer);
+	glDeleteBuffers(1, &_tileBoundsBuffer);
+	glDeleteVertexArrays(1, &_meshVAO);
+	_posVBO = _indicesEBO = _tilesVBO = _commandsBuffer = _tileBoundsBuffer = _meshVAO = 0;
+}
+
+void OceanMesh::stageMesh(int size, MeshMode mode) {
+	discardStaged();
+	_staging = true;
+	_stagedGeneration = std::async(std::launch::async, generateMesh, size, mode);
+}
+
+bool OceanMesh::uploadStaged() {
+	if (!_staging)
+		return true;
+
+	if (_stagedGeneration.valid()) {
+		if (_stagedGeneration.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+		_staged = _stagedGeneration.get();
+
+		// Storage for the whole grid up front, filled a slice per call
+		if (!_staged.mesh.indices.empty()) {
+			glCreateBuffers(1, &_stagedIndicesEBO);
+			glNamedBufferStorage(_stagedIndicesEBO, _staged.mesh.indices.size() * sizeof(unsigned short), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		}
+		if (!_staged.mesh.positions.empty()) {
+			glCreateBuffers(1, &_stagedPosVBO);
+			glNamedBufferStorage(_stagedPosVBO, _staged.mesh.positions.size() * sizeof(glm::vec3), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		}
+	}
+
+	// The indices, then the positions
+	size_t indexBytes = _staged.mesh.indices.size() * sizeof(unsigned short);
+	size_t positionBytes = _staged.mesh.positions.size() * sizeof(glm::vec3);
+	size_t end = std::min(_stagedUploaded + kStagedUploadBytes, indexBytes + positionBytes);
+
+	if (_stagedUploaded < indexBytes) {
+		size_t sliceEnd = std::min(end, indexBytes);
+		glNamedBufferSubData(_stagedIndicesEBO, _stagedUploaded, sliceEnd - _stagedUploaded, (char const*)_staged.mesh.indices.data() + _stagedUploaded);
+		_stagedUploaded = sliceEnd;
+	}
+	if (_stagedUploaded < end) {
+		size_t offset = _stagedUploaded - indexBytes;
+		glNamedBufferSubData(_stagedPosVBO, offset, end - _stagedUploaded, (char const*)_staged.mesh.positions.data() + offset);
+		_stagedUploaded = end;
+	}
+
+	return _stagedUploaded == indexBytes + positionBytes;
+}
+
+void OceanMesh::swapStaged() {
+	if (!_staging)
+		return;
+
+	// The programs are kept, createVAO takes them again without compiling anything
+	deleteGridBuffers();
+
+	GLsizei indexCount = (GLsizei)_staged.mesh.indices.size();
+	_staged.mesh = Mesh();
+	setMesh(std::move(_staged));
+
+	_indicesEBO = std::exchange(_stagedIndicesEBO, 0);
+	_posVBO = std::exchange(_stagedPosVBO, 0);
+	_indexCount = indexCount;
+	createVAO();
+
+	discardStaged();
+}
+
+void OceanMesh::discardStaged() {
+	// Waits for a generation that's still running
+	_stagedGeneration = std::future<MeshData>();
+
+	glDeleteBuffers(1, &_stagedIndicesEBO);
+	glDeleteBuffers(1, &_stagedPosVBO);
+	_stagedIndicesEBO = _stagedPosVBO = 0;
+
+	_staged = MeshData();
+	_stagedUploaded = 0;
+	_staging = false;
+}
+
 GLuint OceanMesh::getMeshVAO() {
 	return _meshVAO;
 }
 
-Mesh OceanMesh::getMesh() {
+Mesh const& OceanMesh::getMesh() {
 	return _mesh;
+}
+
+MeshMode OceanMesh::getMeshMode() {
+	return _mode;
+}
+
+// Tessellated vertices and triangles and the Tiled instances are only known on the GPU, so both are 0 for those modes
+int OceanMesh::getVertexCount() {
+	return _mode == MeshMode::Tessellation || _mode == MeshMode::Tiled ? 0 : _width * _height * getTileCount();
+}
+
+int OceanMesh::getTriangleCount() {
+	return _mode == MeshMode::Tessellation || _mode == MeshMode::Tiled ? 0 : 2 * (_width - 1) * (_height - 1) * getTileCount();
+}
+
+int OceanMesh::getTileCount() {
+	return _mode == MeshMode::Clipmap ? (int)_tiles.size() : 1;
+}
+
+int OceanMesh::getPatchCount() {
+	return _mode == MeshMode::Tessellation ? _width * _height : 0;
+}
+
+int OceanMesh::getCullingTileCount() {
+	return _mode == MeshMode::Tiled ? 0 : (int)_commands.size();
+}
+
+// Tiles TiledInstances.comp considers every frame, and the most it can draw of each level
+int OceanMesh::getTiledCandidateCount() {
+	return _mode == MeshMode::Tiled ? tiledTilesAcross() * tiledTilesAcross() : 0;
+}
+
+// Over every range of the index buffer once, with the base vertices applied. A clipmap tile's commands all draw the whole buffer.
+float OceanMesh::getCacheMissRatio(int cacheSize) {
+	std::vector<unsigned int> indices;
+	if (_mode == MeshMode::Clipmap) {
+		indices.assign(_mesh.indices.begin(), _mesh.indices.end());
+	}
+	else {
+		for (DrawElementsIndirectCommand const& command : _commands) {
+			for (GLuint i = command.firstIndex; i < command.firstIndex + command.count; i++)
+				indices.push_back(_mesh.indices[i] + command.baseVertex);
+		}
+	}
+
+	return fifoCacheMissRatio(indices, cacheSize);
+}
+
+void OceanMesh::setCacheOptimisedIndices(bool enabled) {
+	_cacheOptimisedIndices = enabled;
+}
+
+void OceanMesh::setFrustumCulling(bool enabled) {
+	_frustumCulling = enabled;
+}
+
+bool OceanMesh::getFrustumCulling() {
+	return _frustumCulling;
+}
+
+std::vector<glm::vec2> const& OceanMesh::getMorphRanges() {
+	return _morphRanges;
 }
\ No newline at end of file
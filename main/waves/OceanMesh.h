@@ -1,29 +1,171 @@
 #pragma once
 
+#include <atomic>
+#include <future>
 #include <vector>
 
 #include "glm/glm.hpp"
 #include "glad/glad.h"
 
+#include "../shaders/ComputeShader.h"
+
 struct Mesh {
 	std::vector<glm::vec3> positions;
-	std::vector<unsigned int> indices;
+	std::vector<unsigned short> indices; // Numbered from each draw command's base vertex
+};
+
+// How the ocean grid reaches the vertex shader
+enum class MeshMode {
+	Indexed,		// Position and index buffers, 12 bytes per vertex and 24 bytes per quad
+	VertexPulling,	// No buffers, PBR.vert derives each position from gl_VertexID and gl_InstanceID
+	Clipmap,		// Tiles around the camera that coarsen with distance, out to the far plane (see OceanMesh::update)
+	Tessellation,	// Coarse patches subdivided on the GPU by the length of their edges on screen (PBR.tesc)
+	Tiled			// One tile repeated around the camera out to the far plane, each instance's level of detail picked on the GPU
+};
+
+// An instance of the clipmap tile, a per-instance attribute of PBR.vert
+struct ClipmapTile {
+	glm::vec2 origin; // World xz of the tile's first vertex
+	float spacing; // Between vertices, doubling with every level
+	float level;
+};
+
+// glMultiDrawElementsIndirect's command layout, one per culling tile or per level of the Tiled mesh
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Everything initialiseMesh generates for a grid before createVAO uploads it
+struct MeshData {
+	MeshMode mode = MeshMode::VertexPulling;
+	int width = 0;
+	int height = 0;
+	Mesh mesh;
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<glm::vec4> tileBounds; // Undisplaced xz bounds (minimum, maximum) of each culling tile
+	std::vector<glm::vec2> morphRanges;
 };
 
 class OceanMesh {
 public:
-	static void initialiseMesh(int size);
-	static void createPlaneMesh(int width, int height);
+	static void initialiseMesh(int size, MeshMode mode = MeshMode::VertexPulling);
+	// initialiseMesh without touching the current grid, so it can run on another thread while that one is drawn
+	static MeshData generateMesh(int size, MeshMode mode);
+	static void setMesh(MeshData data);
 	static void createVAO();
+
+	// Replaces the grid without stalling a frame: stageMesh generates the new one on another thread, each
+	// uploadStaged call uploads up to kStagedUploadBytes of it into buffers of its own while the current grid is
+	// still drawn, and once uploadStaged returns true swapStaged makes it the current grid. Without a staged grid
+	// uploadStaged returns true and swapStaged does nothing. Staging another or discarding waits for a generation
+	// still running.
+	static void stageMesh(int size, MeshMode mode);
+	static bool uploadStaged();
+	static void swapStaged();
+	static void discardStaged();
+	static void update(glm::vec3 cameraPosition);
+	// Hides the tiles whose displaced bounds are outside the frustum, on the GPU. displacementBounds is WaveCascadeSet::_displacementBounds.
+	// For MeshMode::Tiled this also places the instances around the camera and picks their levels of detail.
+	static void cull(glm::mat4 viewProjection, GLuint displacementBounds, int cascadeCount);
+	static void draw();
+	// Also discards a staged grid
+	static void deleteBuffers();
 	static GLuint getMeshVAO();
-	static Mesh getMesh();
+	// Empty once createVAO has uploaded it
+	static Mesh const& getMesh();
+	static MeshMode getMeshMode();
+	static int getVertexCount();
+	static int getTriangleCount();
+	static int getTileCount();
+	static int getPatchCount();
+	static int getCullingTileCount();
+	static int getTiledCandidateCount();
+
+	// Culls the Indexed grid and the Clipmap tiles with TileCulling.comp and the Tessellation patches in PBR.tesc,
+	// on by default. Without it every triangle is drawn.
+	static void setFrustumCulling(bool enabled);
+	static bool getFrustumCulling();
+	// Start and end of each level's morph, for Clipmap and Tiled
+	static std::vector<glm::vec2> const& getMorphRanges();
+
+	// Average cache miss ratio, vertex shader invocations per triangle, of the index buffer through a FIFO post-transform
+	// cache of cacheSize vertices. Only between initialiseMesh and createVAO, and 0 without an index buffer.
+	static float getCacheMissRatio(int cacheSize = kVertexCacheSize);
+	// On by default, off lays the quads out row by row instead of in cache sized strips. Applies from the next initialiseMesh.
+	static void setCacheOptimisedIndices(bool enabled);
+
+	// Clipmap tiles are kClipmapTileSize quads across (even, so every other vertex can morph away). Level l's
+	// tiles have a spacing of 2^l and are drawn up to kClipmapBaseRange * 2^l from the camera, where they have
+	// fully morphed into level l + 1's grid. The range has to be about five tiles for neighbouring tiles to
+	// never be more than a level apart, and the coarsest level reaches past renderScene's far plane.
+	static constexpr int kClipmapTileSize = 16;
+	static constexpr int kClipmapLevels = 5;
+	static constexpr float kClipmapBaseRange = 80.0f;
+	static constexpr float kClipmapMorphStart = 0.8f; // Fraction of a level's range where its morph begins
+
+	// Quads across a culling tile of the Indexed grid, whose triangles and vertices are stored tile by tile
+	static constexpr int kCullingTileSize = 32;
+	static_assert((kCullingTileSize + 1) * (kCullingTileSize + 1) <= 65536, "A culling tile's vertices must fit 16 bit indices");
+
+	// Grids are indexed in strips of kCacheStripWidth quads, so a row of a strip's vertices is still in the post-transform
+	// cache when the next row is drawn. A strip needs about twice its width in entries, so 8 quads reuse every vertex of
+	// a cache of 24 or more, and kVertexCacheSize is the FIFO the benchmark reports the miss ratio for.
+	static constexpr int kCacheStripWidth = 8;
+	static constexpr int kVertexCacheSize = 32;
+
+	// A Tiled instance is kTiledTileSize units across, with kTiledTileSize >> l quads a side at level l. Levels are
+	// used up to kTiledBaseRange * 2^l from the camera and morph like the clipmap's, the same constraints on the ranges
+	// apply with the tile's size in place of level 0's. Tiles further away than kTiledDrawDistance, renderScene's far
+	// plane, aren't drawn.
+	static constexpr int kTiledTileSize = 64;
+	static constexpr int kTiledLevels = 4;
+	static constexpr float kTiledBaseRange = 160.0f;
+	static constexpr float kTiledDrawDistance = 1000.0f;
+
+	// Of the staged grid's buffers per uploadStaged call, about 13 calls for the Indexed grid at 2048x2048
+	static constexpr size_t kStagedUploadBytes = 8 << 20;
+
+	// Units across a tessellation patch. At most 64 subdivisions per edge keeps the finest spacing a quarter of the untessellated grid's.
+	static constexpr int kPatchSize = 16;
 
 private:
+	static void createPlaneMesh(MeshData& data, int width, int height);
+	static void cullTiles(glm::mat4 viewProjection, GLuint displacementBounds, int cascadeCount);
+	// The current grid's buffers and VAO, not its programs
+	static void deleteGridBuffers();
+
 	static int _width;
 	static int _height;
+	static MeshMode _mode;
 	static GLuint _posVBO;
 	static GLuint _indicesEBO;
 	static GLuint _meshVAO;
+	static GLuint _tilesVBO;
+	static std::vector<ClipmapTile> _tiles;
+
+	// One draw command and the undisplaced xz bounds (minimum, maximum) of each culling tile. Tiled has a command per
+	// level and no bounds, its instances are culled as they're placed.
+	static std::vector<DrawElementsIndirectCommand> _commands;
+	static std::vector<glm::vec4> _tileBounds;
+	static GLuint _commandsBuffer;
+	static GLuint _tileBoundsBuffer;
+	static ComputeShader _tileCulling;
+	static ComputeShader _tiledInstances;
+	static glm::vec3 _cameraPosition;
+	static bool _frustumCulling;
+	static std::atomic<bool> _cacheOptimisedIndices; // Read by generateMesh on other threads
 	static Mesh _mesh;
-};
+	static GLsizei _indexCount;
+	static std::vector<glm::vec2> _morphRanges;
 
+	static bool _staging;
+	static std::future<MeshData> _stagedGeneration; // Valid until uploadStaged finds it done
+	static MeshData _staged;
+	static GLuint _stagedIndicesEBO;
+	static GLuint _stagedPosVBO;
+	static size_t _stagedUploaded; // Bytes of the indices and then the positions
+};
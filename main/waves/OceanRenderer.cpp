@@ -0,0 +1,76 @@
+#include "OceanRenderer.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "OceanMesh.h"
+#include "../shaders/ShaderManager.h"
+#include "../utils/GpuProfiler.h"
+
+void renderOcean(WaveCascadeSet const& waves, int size, OceanView const& view, OceanMaterial const& material, bool wireframe) {
+	glm::mat4 mvpMatrix = view.projection * view.view;
+
+	// Tiles around the camera and which of them are on screen
+	OceanMesh::update(view.cameraPosition);
+	OceanMesh::cull(mvpMatrix, waves._displacementBounds, waves.cascadeCount());
+
+	GpuProfiler::Scope scope("PBR");
+
+	MeshMode mode = OceanMesh::getMeshMode();
+	ShaderManager::enableShader(mode == MeshMode::Tessellation ? "PBRTessellation" : "PBR");
+
+	glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
+	glUniform1i(1, size);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, waves._displacementTexture.id());
+
+	// A tile size per cascade, PBR.vert has a uniform for each
+	static_assert(kCascadeCount == 3, "PBR.vert samples three cascades");
+	glUniform1i(2, waves._cascades[0]._spectrum.scale);
+	glUniform1i(3, waves._cascades[1]._spectrum.scale);
+	glUniform1i(4, waves._cascades[2]._spectrum.scale);
+
+	glUniform3fv(5, 1, glm::value_ptr(view.cameraPosition));
+	glUniform3fv(6, 1, glm::value_ptr(material.lightPosition));
+	glUniform3fv(7, 1, glm::value_ptr(material.lightColor));
+
+	glUniform3fv(8, 1, glm::value_ptr(material.albedo));
+	glUniform1f(9, material.metallic);
+	glUniform1f(10, material.roughness);
+	glUniform1f(11, material.ao);
+
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, waves._derivativesTexture.id());
+
+	glActiveTexture(GL_TEXTURE6);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, waves._foamTexture.id());
+
+	glUniform1f(12, material.foamStrength);
+
+	// Pass wireframe state so we can color the wireframe in black if enabled
+	glUniform1i(13, wireframe);
+
+	// How PBR.vert finds its vertices
+	glUniform1i(14, (int)mode);
+	if (mode == MeshMode::Clipmap || mode == MeshMode::Tiled) {
+		std::vector<glm::vec2> const& morphRanges = OceanMesh::getMorphRanges();
+		glUniform1i(15, mode == MeshMode::Tiled ? OceanMesh::kTiledTileSize : OceanMesh::kClipmapTileSize);
+		glUniform2fv(16, (GLsizei)morphRanges.size(), glm::value_ptr(morphRanges[0]));
+	}
+	else if (mode == MeshMode::Tessellation) {
+		glUniform1i(15, OceanMesh::kPatchSize);
+		glUniform1f(24, material.tessellationEdge);
+		glUniform2fv(25, 1, glm::value_ptr(view.viewportSize));
+		glUniform1i(26, OceanMesh::getFrustumCulling());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, waves._displacementBounds);
+	}
+
+	// Wireframe should only alter water mesh
+	glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
+
+	OceanMesh::draw();
+
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	ShaderManager::disableShader();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include "WaveCascadeSet.h"
+
+// The water's lighting and material, the PBR shader's uniforms besides the geometry
+struct OceanMaterial {
+	glm::vec3 lightPosition = glm::vec3(512.0f, 300.0f, 512.0f);
+	glm::vec3 lightColor = glm::vec3(300.0f);
+	glm::vec3 albedo = glm::vec3(0.016f, 0.118f, 0.745f);
+	float metallic = 0.0f;
+	float roughness = 0.1f;
+	float ao = 0.25f;
+	float foamStrength = 1.9f;
+
+	float tessellationEdge = 8.0f; // Target length of a tessellated edge in pixels, MeshMode::Tessellation only
+};
+
+// Where the ocean is seen from
+struct OceanView {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 cameraPosition;
+	glm::vec2 viewportSize;
+};
+
+// Draws OceanMesh displaced by the cascades, with the shader and uniforms its MeshMode needs.
+// Shared by the application and the benchmark so both render the same thing.
+void renderOcean(WaveCascadeSet const& waves, int size, OceanView const& view, OceanMaterial const& material, bool wireframe = false);
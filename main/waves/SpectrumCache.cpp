@@ -0,0 +1,202 @@
+#include "SpectrumCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "FastFourierTransform.h"
+#include "../shaders/ShaderManager.h"
+#include "../utils/Hash.h"
+#include "../utils/MappedFile.h"
+
+std::string SpectrumCache::_directory;
+std::list<SpectrumCache::PendingStore> SpectrumCache::_pending;
+
+namespace {
+	char const kMagic[4] = { 'W', 'S', 'P', 'C' };
+
+	// The shaders Waves computes the initial spectra with, including the noise they're drawn from
+	char const* const kSpectrumShaders[] = { "../shaders/GaussianNoise.comp", "../shaders/WaveSpectra.comp", "../shaders/WaveSpectraConjugate.comp" };
+
+	// Bytes of one of the arrays, every layer
+	size_t arrayBytes(int size, int cascadeCount) {
+		return (size_t)FastFourierTransform::halfSpectrumWidth(size) * size * cascadeCount * 4 * sizeof(float);
+	}
+}
+
+void SpectrumCache::setDirectory(std::string const& directory) {
+	_directory = directory;
+}
+
+std::string const& SpectrumCache::getDirectory() {
+	return _directory;
+}
+
+uint64_t SpectrumCache::key(int size, unsigned int seed, std::vector<SpectrumParameters> const& spectra) {
+	uint64_t hash = hashBytes(&kVersion, sizeof(kVersion));
+	hash = hashBytes(&size, sizeof(size), hash);
+	hash = hashBytes(&seed, sizeof(seed), hash);
+	// Only floats and ints, so there's no padding to hash
+	for (SpectrumParameters const& spectrum : spectra)
+		hash = hashBytes(&spectrum, sizeof(spectrum), hash);
+	for (char const* shader : kSpectrumShaders) {
+		std::string source = ShaderManager::readShaderSource(shader);
+		hash = hashBytes(source.data(), source.size(), hash);
+	}
+	return hash;
+}
+
+std::string SpectrumCache::entryPath(uint64_t key) {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.spectra", (unsigned long long)key);
+	return (std::filesystem::path(_directory) / name).string();
+}
+
+bool SpectrumCache::load(int size, unsigned int seed, std::vector<SpectrumParameters> const& spectra, GLuint h0Texture, GLuint waveDataTexture) {
+	if (_directory.empty())
+		return false;
+
+	uint64_t entryKey = key(size, seed, spectra);
+	MappedFile file(entryPath(entryKey));
+
+	int cascadeCount = (int)spectra.size();
+	size_t parametersBytes = spectra.size() * sizeof(SpectrumParameters);
+	size_t dataBytes = arrayBytes(size, cascadeCount);
+	if (!file.isOpen() || file.size() != sizeof(Header) + parametersBytes + 2 * dataBytes)
+		return false;
+
+	Header header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || header.key != entryKey
+		|| header.size != size || header.cascadeCount != cascadeCount || header.seed != seed)
+		return false;
+
+	unsigned char const* parameters = file.data() + sizeof(Header);
+	for (int i = 0; i < cascadeCount; i++) {
+		SpectrumParameters cached;
+		std::memcpy(&cached, parameters + i * sizeof(SpectrumParameters), sizeof(cached));
+		if (!(cached == spectra[i]))
+			return false;
+	}
+
+	// Straight from the mapping, the pages are only read as the upload touches them
+	unsigned char const* h0 = parameters + parametersBytes;
+	int width = FastFourierTransform::halfSpectrumWidth(size);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTextureSubImage3D(h0Texture, 0, 0, 0, 0, width, size, cascadeCount, GL_RGBA, GL_FLOAT, h0);
+	glTextureSubImage3D(waveDataTexture, 0, 0, 0, 0, width, size, cascadeCount, GL_RGBA, GL_FLOAT, h0 + dataBytes);
+
+	return true;
+}
+
+void SpectrumCache::store(int size, unsigned int seed, std::vector<SpectrumParameters> const& spectra, GLuint h0Texture, GLuint waveDataTexture) {
+	if (_directory.empty())
+		return;
+
+	uint64_t entryKey = key(size, seed, spectra);
+	for (PendingStore const& pending : _pending) {
+		if (pending.header.key == entryKey)
+			return;
+	}
+
+	PendingStore& store = _pending.emplace_back();
+	std::memcpy(store.header.magic, kMagic, sizeof(kMagic));
+	store.header.version = kVersion;
+	store.header.key = entryKey;
+	store.header.size = size;
+	store.header.cascadeCount = (int32_t)spectra.size();
+	store.header.seed = seed;
+	store.spectra = spectra;
+	store.path = entryPath(entryKey);
+
+	// Coherent, so a signalled fence is all it takes for the copy to be visible through the mapping
+	size_t dataBytes = arrayBytes(size, (int)spectra.size());
+	store.bytes = 2 * dataBytes;
+	GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &store.buffer);
+	glNamedBufferStorage(store.buffer, (GLsizeiptr)store.bytes, nullptr, flags);
+	store.mapped = (unsigned char const*)glMapNamedBufferRange(store.buffer, 0, (GLsizeiptr)store.bytes, flags);
+
+	// The spectra were written with image stores
+	glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, store.buffer);
+	glGetTextureImage(h0Texture, 0, GL_RGBA, GL_FLOAT, (GLsizei)dataBytes, nullptr);
+	glGetTextureImage(waveDataTexture, 0, GL_RGBA, GL_FLOAT, (GLsizei)dataBytes, (void*)dataBytes);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// The flush makes sure the fence reaches the GPU even if nothing else is submitted before the next poll
+	store.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+}
+
+void SpectrumCache::update() {
+	for (auto store = _pending.begin(); store != _pending.end(); ) {
+		if (store->fence != nullptr) {
+			if (glClientWaitSync(store->fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+				glDeleteSync(store->fence);
+				store->fence = nullptr;
+
+				PendingStore const& finished = *store;
+				store->written = std::async(std::launch::async, [&finished] { write(finished); });
+			}
+			++store;
+		}
+		else if (store->written.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			deleteStore(*store);
+			store = _pending.erase(store);
+		}
+		else {
+			++store;
+		}
+	}
+}
+
+void SpectrumCache::finish() {
+	for (PendingStore& store : _pending) {
+		if (store.fence != nullptr) {
+			glClientWaitSync(store.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(store.fence);
+			store.fence = nullptr;
+			write(store);
+		}
+		else {
+			store.written.wait();
+		}
+
+		deleteStore(store);
+	}
+
+	_pending.clear();
+}
+
+void SpectrumCache::write(PendingStore const& store) {
+	// Written to a temporary name and renamed, so a reader never maps a half written entry
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(store.path).parent_path(), error);
+	std::string const& path = store.path;
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary);
+		file.write((char const*)&store.header, sizeof(store.header));
+		file.write((char const*)store.spectra.data(), store.spectra.size() * sizeof(SpectrumParameters));
+		file.write((char const*)store.mapped, store.bytes);
+
+		if (!file) {
+			std::fprintf(stderr, "Could not write spectrum cache entry: %s\n", temporaryPath.c_str());
+			return;
+		}
+	}
+
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+		std::fprintf(stderr, "Could not write spectrum cache entry: %s (%s)\n", path.c_str(), error.message().c_str());
+}
+
+void SpectrumCache::deleteStore(PendingStore& store) {
+	glUnmapNamedBuffer(store.buffer);
+	glDeleteBuffers(1, &store.buffer);
+	store.buffer = 0;
+	store.mapped = nullptr;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "glad/glad.h"
+
+#include "SpectrumParameters.h"
+
+// Initial spectra (the h0 and wave data layers of every cascade) kept on disk, so sea states that have been
+// seen before start without running WaveSpectra.comp. An entry is keyed by a hash of everything the spectra are
+// computed from: the grid size, the noise seed, every cascade's SpectrumParameters (which is what WaveData decides)
+// and the source of the noise and spectrum shaders, so an edited or hot reloaded shader is a miss rather than stale spectra.
+// Entries are memory mapped and uploaded straight from the mapping. Storing one never stalls a frame: the arrays
+// are copied into a pixel pack buffer and fenced, and once the GPU has finished a worker thread writes the file.
+//
+// File layout: a Header, the SpectrumParameters of every cascade (checked against the request, so a hash
+// collision is a miss), then the h0 array and the wave data array as RGBA32F, cascade by cascade.
+class SpectrumCache {
+public:
+	// Bumped whenever the file layout changes, older entries are then misses
+	static constexpr uint32_t kVersion = 1;
+
+	// Where entries are read and written, empty (the default) disables the cache
+	static void setDirectory(std::string const& directory);
+	static std::string const& getDirectory();
+
+	static uint64_t key(int size, unsigned int seed, std::vector<SpectrumParameters> const& spectra);
+	static std::string entryPath(uint64_t key);
+
+	// Uploads the spectra into every layer of the h0 and wave data arrays, false if there's no matching entry
+	static bool load(int size, unsigned int seed, std::vector<SpectrumParameters> const& spectra, GLuint h0Texture, GLuint waveDataTexture);
+	// Starts copying the arrays back as the entry for these inputs and returns, update() writes it once the copy
+	// has finished. Failing to write only warns.
+	static void store(int size, unsigned int seed, std::vector<SpectrumParameters> const& spectra, GLuint h0Texture, GLuint waveDataTexture);
+	// Call once a frame on the GL thread: hands the finished copies to a writing thread and frees the written ones
+	static void update();
+	// Waits for every store in flight to be written and frees its buffer, e.g. before the context goes
+	static void finish();
+
+private:
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		int32_t size;
+		int32_t cascadeCount;
+		uint32_t seed;
+		uint32_t padding;
+	};
+
+	struct PendingStore {
+		Header header{};
+		std::vector<SpectrumParameters> spectra;
+		std::string path; // Of the entry, decided when it's stored
+		GLuint buffer = 0;
+		unsigned char const* mapped = nullptr; // Both arrays, persistently mapped
+		size_t bytes = 0;
+		GLsync fence = nullptr; // Set while the copy is in flight
+		std::future<void> written; // Valid once the file is being written
+	};
+
+	// Runs on the writing thread, only reads the store
+	static void write(PendingStore const& store);
+	static void deleteStore(PendingStore& store);
+
+	static std::string _directory;
+	static std::list<PendingStore> _pending; // A list so the writing threads' references stay valid
+};
@@ -0,0 +1,58 @@
+#include "SpectrumParameters.h"
+
+#include <cmath>
+
+const float PI = 3.14159274f;
+
+float jonswapPeakFrequency(float g, float fetch, float windspeed) {
+	return 22 * std::pow(windspeed * fetch / g / g, -0.33f);
+}
+
+float jonswapAlpha(float g, float fetch, float windspeed) {
+	return 0.076f * std::pow(g * fetch / windspeed / windspeed, -0.22f);
+}
+
+SpectrumParameters::SpectrumParameters() {
+	peakOmega = jonswapPeakFrequency(gravity, fetch, windSpeed);
+	alpha = jonswapAlpha(gravity, fetch, windSpeed);
+}
+
+void SpectrumParameters::applyWaveData(WaveData waveData) {
+	peakOmega = jonswapPeakFrequency(waveData.gravity, waveData.fetch, waveData.windSpeed);
+	alpha = jonswapAlpha(waveData.gravity, waveData.fetch, waveData.windSpeed);
+	windDirection = waveData.angle;
+}
+
+float SpectrumParameters::cutoffLowSquared() const {
+	float radius = cutoffLow * scale / (2 * PI);
+	return radius * radius;
+}
+
+float SpectrumParameters::cutoffHighSquared() const {
+	float radius = cutoffHigh * scale / (2 * PI);
+	return radius * radius;
+}
+
+std::vector<SpectrumParameters> cascadeSpectra(WaveData waveData) {
+	float edge1 = 2 * PI / waveData.scale2 * 10.0f;
+	float edge2 = 2 * PI / waveData.scale3 * 10.0f;
+
+	std::vector<SpectrumParameters> spectra(kCascadeCount);
+
+	spectra[0].scale = waveData.scale1;
+	spectra[0].cutoffLow = 0.0001f;
+	spectra[0].cutoffHigh = edge1;
+
+	spectra[1].scale = waveData.scale2;
+	spectra[1].cutoffLow = edge1;
+	spectra[1].cutoffHigh = edge2;
+
+	spectra[2].scale = waveData.scale3;
+	spectra[2].cutoffLow = edge2;
+	spectra[2].cutoffHigh = 9999.9f;
+
+	for (SpectrumParameters& spectrum : spectra)
+		spectrum.applyWaveData(waveData);
+
+	return spectra;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include "WaveData.h"
+
+float jonswapPeakFrequency(float g, float fetch, float windspeed);
+float jonswapAlpha(float g, float fetch, float windspeed);
+
+// Everything the initial spectrum of a cascade is computed from. Shared by the GPU cascades (Waves)
+// and the CpuOceanEngine so both evaluate exactly the same spectrum.
+struct SpectrumParameters {
+	SpectrumParameters();
+
+	// Wind, as WaveData does in the settings window: the peak frequency, alpha and direction change,
+	// the spectrum keeps its own gravity, depth and wind speed
+	void applyWaveData(WaveData waveData);
+
+	float gravity = 9.81f;
+	float fetch = 100000.0f;
+	float depth = 500.0f;
+	float windSpeed = 7.29f;
+	float windDirection = 29.81f;
+	float peakOmega;
+	float alpha;
+
+	// Side length of the tile in metres and the band of wavenumbers this cascade holds
+	int scale = 250;
+	float cutoffLow = 0.0001f;
+	float cutoffHigh = 9999.9f;
+
+	// The cutoffs as squared radii in texels of the spectrum. Both engines compare a texel's integer nx² + nz² against
+	// these rather than its wavenumber against the cutoffs, so a texel on a band edge is in the same band on either.
+	float cutoffLowSquared() const;
+	float cutoffHighSquared() const;
+
+	// Equal parameters give the same initial spectrum, so only cascades whose parameters changed are recomputed
+	bool operator==(SpectrumParameters const&) const = default;
+};
+
+// Cascades of every ocean, one per WaveData scale. PBR.vert and OceanRenderer sample this many layers.
+constexpr int kCascadeCount = 3;
+
+// The spectra of the kCascadeCount cascades for the wind in waveData, each holding the wavenumbers between its
+// neighbours. Used both to create the cascades and to update them, so the band edges are always the same.
+std::vector<SpectrumParameters> cascadeSpectra(WaveData waveData);
@@ -0,0 +1,58 @@
+#include "WaveCascadeBuilder.h"
+
+#include <utility>
+
+namespace {
+	// FFT, set, noise, then one per cascade
+	const int kStepCount = 3 + kCascadeCount;
+}
+
+WaveCascadeBuilder::WaveCascadeBuilder(WaveData waveData, int size, FastFourierTransform::Mode fftMode) :
+	_waveData(waveData),
+	_size(size),
+	_fftMode(fftMode)
+{}
+
+bool WaveCascadeBuilder::step() {
+	if (isComplete())
+		return true;
+
+	switch (_step) {
+	case 0:
+		_fft = FastFourierTransform(_size, _fftMode);
+		break;
+	case 1:
+		_waves = WaveCascadeSet(_size, std::move(_fft), _waveData.precision);
+		break;
+	case 2:
+		_waves.generateNoise(_waveData.seed);
+		break;
+	case 3:
+		// A cached sea state needs no spectra computed at all
+		if (_waves.loadCachedSpectra(_waveData)) {
+			_step = kStepCount;
+			return true;
+		}
+		[[fallthrough]];
+	default:
+		_waves.initCascade(_step - 3, _waveData);
+		if (_step == kStepCount - 1)
+			_waves.storeCachedSpectra();
+		break;
+	}
+
+	_step++;
+	return isComplete();
+}
+
+bool WaveCascadeBuilder::isComplete() const {
+	return _step == kStepCount;
+}
+
+int WaveCascadeBuilder::size() const {
+	return _size;
+}
+
+WaveCascadeSet& WaveCascadeBuilder::result() {
+	return _waves;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "WaveCascadeSet.h"
+
+// Builds a WaveCascadeSet one piece per step() so a new grid size can be prepared over several frames while the
+// current set keeps rendering. GL can't be used from another thread without a second context, so the work is
+// split into steps small enough to hide in a frame instead: the FFT's shaders and twiddles, the set's shaders and
+// texture arrays, the noise, then each cascade's initial spectrum, or all of them at once from the SpectrumCache.
+class WaveCascadeBuilder {
+public:
+	WaveCascadeBuilder(WaveData waveData, int size, FastFourierTransform::Mode fftMode = FastFourierTransform::Mode::Auto);
+
+	// Runs the next step, returns true once the set is complete
+	bool step();
+	bool isComplete() const;
+
+	int size() const;
+	// The set as built so far, move it out once complete. An abandoned build releases it with the builder.
+	WaveCascadeSet& result();
+
+private:
+	WaveData _waveData;
+	int _size;
+	FastFourierTransform::Mode _fftMode;
+
+	int _step = 0;
+	// Built by the first step, handed to the set by the second
+	FastFourierTransform _fft;
+	WaveCascadeSet _waves;
+};
@@ -0,0 +1,269 @@
+#include "WaveCascadeSet.h"
+
+#include <utility>
+
+#include "../utils/GpuProfiler.h"
+#include "SpectrumCache.h"
+
+namespace {
+	PooledTexture createTextureArray(GLenum internalFormat, int width, int height, int layers, GLint filter) {
+		PooledTexture texture(GL_TEXTURE_2D_ARRAY, internalFormat, width, height, layers);
+		glTextureParameteri(texture.id(), GL_TEXTURE_MIN_FILTER, filter);
+		glTextureParameteri(texture.id(), GL_TEXTURE_MAG_FILTER, filter);
+
+		return texture;
+	}
+
+	// Formats of the displacement and derivatives textures, must match the shader's OUTPUT_FORMAT
+	GLenum outputFormat(WavePrecision precision) {
+		return precision == WavePrecision::Half ? GL_RGBA16F : GL_RGBA32F;
+	}
+
+	// Only the foam texture's first channel is used, must match the shader's FOAM_FORMAT
+	GLenum foamFormat(WavePrecision precision) {
+		return precision == WavePrecision::Half ? GL_R16F : GL_R32F;
+	}
+}
+
+WaveCascadeSet::WaveCascadeSet() {}
+
+WaveCascadeSet::WaveCascadeSet(int size, FastFourierTransform fft, WavePrecision precision) :
+	_fft(std::move(fft)),
+	_size(size),
+	_cascadeCount(kCascadeCount),
+	_precision(precision)
+{
+	_timeDependentSpectra = ComputeShader("../shaders/TimeDependentSpectra.comp");
+
+	// The fields are real so their spectra are Hermitian, only half of each spectrum is stored
+	int spectrumWidth = FastFourierTransform::halfSpectrumWidth(size);
+
+	// The initial spectra are written by each cascade into its own layer
+	_h0Texture = createTextureArray(GL_RGBA32F, spectrumWidth, size, _cascadeCount, GL_NEAREST);
+	_waveDataTexture = createTextureArray(GL_RGBA32F, spectrumWidth, size, _cascadeCount, GL_NEAREST);
+
+	// All spectra of all cascades are layers of one array so a single set of FFT dispatches transforms everything
+	_spectraTexture = createTextureArray(GL_RGBA32F, spectrumWidth, size, _cascadeCount * SpectraLayerCount, GL_NEAREST);
+
+	createOutputs(precision);
+
+	glCreateBuffers(1, &_displacementBounds);
+	glNamedBufferStorage(_displacementBounds, _cascadeCount * 4 * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	for (int i = 0; i < _cascadeCount; i++)
+		_cascades.push_back(Waves(size, i, _h0Texture.id(), _waveDataTexture.id()));
+}
+
+WaveCascadeSet::~WaveCascadeSet() {
+	glDeleteBuffers(1, &_displacementBounds);
+}
+
+WaveCascadeSet::WaveCascadeSet(WaveCascadeSet&& other) noexcept {
+	*this = std::move(other);
+}
+
+WaveCascadeSet& WaveCascadeSet::operator=(WaveCascadeSet&& other) noexcept {
+	if (this == &other)
+		return *this;
+
+	// The pooled textures and programs release what this set held as they're assigned, the buffer is by hand
+	_cascades = std::move(other._cascades);
+	_timeDependentSpectra = std::move(other._timeDependentSpectra);
+	_textureAssembler = std::move(other._textureAssembler);
+	_h0Texture = std::move(other._h0Texture);
+	_waveDataTexture = std::move(other._waveDataTexture);
+	_spectraTexture = std::move(other._spectraTexture);
+	_displacementTexture = std::move(other._displacementTexture);
+	_derivativesTexture = std::move(other._derivativesTexture);
+	_foamTexture = std::move(other._foamTexture);
+	_noiseTexture = std::move(other._noiseTexture);
+	_fft = std::move(other._fft);
+
+	glDeleteBuffers(1, &_displacementBounds);
+	_displacementBounds = std::exchange(other._displacementBounds, 0);
+
+	_waveData = other._waveData;
+	_size = other._size;
+	_cascadeCount = other._cascadeCount;
+	_precision = other._precision;
+
+	return *this;
+}
+
+void WaveCascadeSet::init(WaveData waveData) {
+	// Still needed when a cached set's spectra change later
+	generateNoise(waveData.seed);
+
+	if (loadCachedSpectra(waveData))
+		return;
+
+	for (int i = 0; i < _cascadeCount; i++)
+		initCascade(i, waveData);
+
+	storeCachedSpectra();
+}
+
+void WaveCascadeSet::initCascade(int cascade, WaveData waveData) {
+	_waveData = waveData;
+	_cascades[cascade].init(cascadeSpectra(waveData)[cascade]);
+}
+
+bool WaveCascadeSet::loadCachedSpectra(WaveData waveData) {
+	std::vector<SpectrumParameters> spectra = cascadeSpectra(waveData);
+	if (!SpectrumCache::load(_size, waveData.seed, spectra, _h0Texture.id(), _waveDataTexture.id()))
+		return false;
+
+	_waveData = waveData;
+	for (int i = 0; i < _cascadeCount; i++)
+		_cascades[i]._spectrum = spectra[i];
+
+	return true;
+}
+
+void WaveCascadeSet::storeCachedSpectra() const {
+	SpectrumCache::store(_size, _waveData.seed, spectra(), _h0Texture.id(), _waveDataTexture.id());
+}
+
+int WaveCascadeSet::applyWaveData(WaveData waveData) {
+	if (waveData == _waveData)
+		return 0;
+
+	// Only the output textures have a precision, the spectra are kept
+	if (waveData.precision != _precision)
+		createOutputs(waveData.precision);
+
+	// Every spectrum is drawn from the noise
+	bool reseeded = waveData.seed != _waveData.seed;
+	if (reseeded)
+		generateNoise(waveData.seed);
+
+	_waveData = waveData;
+
+	// A scale moves the band edges of its neighbours too, the other cascades are left alone
+	std::vector<SpectrumParameters> spectra = cascadeSpectra(waveData);
+
+	int recalculated = 0;
+	for (int i = 0; i < _cascadeCount; i++) {
+		if (!reseeded && spectra[i] == _cascades[i]._spectrum)
+			continue;
+
+		_cascades[i].init(spectra[i]);
+		recalculated++;
+	}
+
+	return recalculated;
+}
+
+void WaveCascadeSet::createOutputs(WavePrecision precision) {
+	_precision = precision;
+
+	if (precision == WavePrecision::Half)
+		_textureAssembler = ComputeShader("../shaders/TextureAssembler.comp", "#define OUTPUT_FORMAT rgba16f\n#define FOAM_FORMAT r16f\n");
+	else
+		_textureAssembler = ComputeShader("../shaders/TextureAssembler.comp");
+
+	// Only sampled by the renderer, so their precision is configurable
+	_displacementTexture = createTextureArray(outputFormat(precision), _size, _size, _cascadeCount, GL_NEAREST);
+	_derivativesTexture = createTextureArray(outputFormat(precision), _size, _size, _cascadeCount, GL_LINEAR);
+	_foamTexture = createTextureArray(foamFormat(precision), _size, _size, _cascadeCount, GL_LINEAR);
+}
+
+void WaveCascadeSet::generateNoise(unsigned int seed) {
+	_noiseTexture = generateGaussianNoise(_size, seed);
+
+	for (Waves& cascade : _cascades)
+		cascade._noiseTexture = _noiseTexture.id();
+}
+
+void WaveCascadeSet::calculateWavesAtTime(float time, float timeDelta) {
+	{
+		GpuProfiler::Scope scope("TimeDependentSpectra");
+
+		glUseProgram(_timeDependentSpectra._programID);
+
+		GLint timeUniform = glGetUniformLocation(_timeDependentSpectra._programID, "time");
+
+		glUniform1f(timeUniform, time);
+
+		glBindImageTexture(0, _spectraTexture.id(), 0, true, 0, GL_READ_WRITE, GL_RGBA32F);
+		glBindImageTexture(4, _h0Texture.id(), 0, true, 0, GL_READ_WRITE, GL_RGBA32F);
+		glBindImageTexture(5, _waveDataTexture.id(), 0, true, 0, GL_READ_WRITE, GL_RGBA32F);
+
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		glDispatchCompute((FastFourierTransform::halfSpectrumWidth(_size) + 7) / 8, _size / 8, _cascadeCount);
+	}
+
+	{
+		GpuProfiler::Scope scope("IFFT");
+		_fft.IFFT2DReal(_spectraTexture.id(), _cascadeCount * SpectraLayerCount);
+	}
+
+	GpuProfiler::Scope scope("TextureAssembler");
+
+	glUseProgram(_textureAssembler._programID);
+
+	GLint timeDeltaUniform = glGetUniformLocation(_textureAssembler._programID, "timeDelta");
+
+	glUniform1f(timeDeltaUniform, timeDelta);
+
+	glBindImageTexture(0, _displacementTexture.id(), 0, true, 0, GL_WRITE_ONLY, outputFormat(_precision));
+	glBindImageTexture(1, _derivativesTexture.id(), 0, true, 0, GL_WRITE_ONLY, outputFormat(_precision));
+	glBindImageTexture(2, _foamTexture.id(), 0, true, 0, GL_READ_WRITE, foamFormat(_precision));
+	glBindImageTexture(3, _spectraTexture.id(), 0, true, 0, GL_READ_WRITE, GL_RGBA32F);
+
+	// The bounds are maxima of this frame's displacement, so they start from zero
+	glClearNamedBufferData(_displacementBounds, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, _displacementBounds);
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	glDispatchCompute(_size / 8, _size / 8, _cascadeCount);
+
+	// Make the results visible to the PBR shader's samplers and the culling pass
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	glUseProgram(0);
+}
+
+int WaveCascadeSet::size() const {
+	return _size;
+}
+
+int WaveCascadeSet::cascadeCount() const {
+	return _cascadeCount;
+}
+
+size_t WaveCascadeSet::cascadeBytes(int cascade) const {
+	PooledTexture const* arrays[] = {
+		&_h0Texture, &_waveDataTexture, &_spectraTexture,
+		&_displacementTexture, &_derivativesTexture, &_foamTexture
+	};
+
+	// Every array has the same number of layers per cascade
+	size_t bytes = 0;
+	for (PooledTexture const* texture : arrays)
+		bytes += texture->bytes() / _cascadeCount;
+
+	return bytes + _cascades[cascade]._h0kTexture.bytes();
+}
+
+size_t WaveCascadeSet::sharedBytes() const {
+	return _noiseTexture.bytes() + _fft._butterflyTexture.bytes() + _fft._halfButterflyTexture.bytes() + _fft._bufferTexture.bytes();
+}
+
+WavePrecision WaveCascadeSet::precision() const {
+	return _precision;
+}
+
+std::vector<SpectrumParameters> WaveCascadeSet::spectra() const {
+	std::vector<SpectrumParameters> spectra;
+	for (Waves const& cascade : _cascades)
+		spectra.push_back(cascade._spectrum);
+
+	return spectra;
+}
+
+WaveCascadeSet initialise(WaveData waveData, int size, FastFourierTransform::Mode fftMode) {
+	WaveCascadeSet waves = WaveCascadeSet(size, FastFourierTransform(size, fftMode), waveData.precision);
+	waves.init(waveData);
+
+	return waves;
+}
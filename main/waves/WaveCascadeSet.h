@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+
+#include "glad/glad.h"
+
+#include "WaveData.h"
+#include "Waves.h"
+#include "FastFourierTransform.h"
+#include "../utils/TexturePool.h"
+
+// All cascades of the ocean, stored as layers of shared texture arrays so the time evolution,
+// FFT and texture assembly run once per frame for every cascade instead of once per cascade.
+//
+// Layer c of the h0, wave data, displacement, derivatives and foam arrays belongs to cascade c,
+// layers 4c to 4c + 3 of the spectra array hold its SpectraLayer textures. The h0, wave data and
+// spectra arrays are half spectra, see FastFourierTransform::IFFT2DReal.
+//
+// Move only: the textures go back to the TexturePool and the programs to the ProgramCache when it's destroyed,
+// which is safe on a partly built set, e.g. an abandoned WaveCascadeBuilder's.
+class WaveCascadeSet {
+public:
+	// Layers of _spectraTexture per cascade, each holding the spectra of two real fields
+	enum SpectraLayer {
+		Choppiness = 0,
+		Elevation,
+		SlopeParams,
+		JacobianParams,
+		SpectraLayerCount
+	};
+
+	WaveCascadeSet();
+	// kCascadeCount cascades, the bands cascadeSpectra splits the ocean into
+	WaveCascadeSet(int size, FastFourierTransform fft, WavePrecision precision = WavePrecision::Full);
+	~WaveCascadeSet();
+
+	WaveCascadeSet(WaveCascadeSet&& other) noexcept;
+	WaveCascadeSet& operator=(WaveCascadeSet&& other) noexcept;
+	WaveCascadeSet(WaveCascadeSet const&) = delete;
+	WaveCascadeSet& operator=(WaveCascadeSet const&) = delete;
+
+	// Generates the noise, then every cascade's initial spectrum, from the SpectrumCache when it has them
+	void init(WaveData waveData);
+	void initCascade(int cascade, WaveData waveData);
+	// Every cascade's initial spectrum from the SpectrumCache, false (and nothing changed) if it doesn't have them
+	bool loadCachedSpectra(WaveData waveData);
+	// Starts storing the initial spectra computed from the WaveData last applied, see SpectrumCache::store()
+	void storeCachedSpectra() const;
+	void generateNoise(unsigned int seed);
+	// Recomputes the initial spectrum of only the cascades whose parameters waveData changes, returns how many. A new
+	// seed regenerates the noise and every cascade, a new precision reallocates the output textures.
+	// Costs a comparison when waveData hasn't changed since the last call, so it can run every frame.
+	int applyWaveData(WaveData waveData);
+	void calculateWavesAtTime(float time, float timeDelta);
+
+	int size() const;
+	int cascadeCount() const;
+	// GPU memory of a cascade's layers of the texture arrays and its own textures
+	size_t cascadeBytes(int cascade) const;
+	// GPU memory the cascades share: the noise and the FFT's textures
+	size_t sharedBytes() const;
+	WavePrecision precision() const;
+
+	// The current spectrum of every cascade, e.g. to run the same ocean on a CpuOceanEngine
+	std::vector<SpectrumParameters> spectra() const;
+
+	std::vector<Waves> _cascades;
+
+	ComputeShader _timeDependentSpectra;
+	ComputeShader _textureAssembler;
+
+	PooledTexture _h0Texture;
+	PooledTexture _waveDataTexture;
+	PooledTexture _spectraTexture;
+
+	PooledTexture _displacementTexture;
+	PooledTexture _derivativesTexture;
+	PooledTexture _foamTexture;
+
+	// Gaussian noise the initial spectra are drawn from, shared by the cascades
+	PooledTexture _noiseTexture;
+
+	// Shader storage buffer with the largest absolute x, y and z displacement of every cascade in the current frame,
+	// a uvec4 of float bits per cascade, written by TextureAssembler.comp for OceanMesh's tile culling
+	GLuint _displacementBounds = 0;
+
+	FastFourierTransform _fft;
+
+private:
+	// The texture assembler and the textures it writes, which are the ones in the precision
+	void createOutputs(WavePrecision precision);
+
+	WaveData _waveData; // The spectra were last computed from
+	int _size = 0;
+	int _cascadeCount = 0;
+	WavePrecision _precision = WavePrecision::Full;
+};
+
+WaveCascadeSet initialise(WaveData waveData, int size, FastFourierTransform::Mode fftMode = FastFourierTransform::Mode::Auto);
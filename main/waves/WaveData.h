@@ -1,13 +1,24 @@
 #pragma once
 
+// Storage precision of the textures sampled by the renderer, the spectra and FFT always use 32 bit floats
+enum class WavePrecision {
+	Full,	// RGBA32F displacement and derivatives, R32F foam
+	Half	// RGBA16F displacement and derivatives, R16F foam
+};
+
 extern struct WaveData {
 	float depth = 500.0f;
-	float windSpeed = 7.3f;
+	float windSpeed = 7.29f;
 	float gravity = 9.81f;
 	float fetch = 100000.0f;
-	float angle = 39.55f;
+	float angle = 29.81f;
 
 	int scale1 = 250; // Large waves
 	int scale2 = 19;
 	int scale3 = 4; // Small waves
+
+	WavePrecision precision = WavePrecision::Half; // Changing it reallocates the textures the renderer samples
+	unsigned int seed = 0; // Of the Gaussian noise, changing it recomputes every cascade
+
+	bool operator==(WaveData const&) const = default;
 } waveData;
\ No newline at end of file
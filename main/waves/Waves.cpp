@@ -1,224 +1,121 @@
 #include "Waves.h"
 #include <numeric>
 
-std::default_random_engine generator;
-std::uniform_real_distribution<float> distribution(0.0, 1.0);
+#include "../utils/GpuProfiler.h"
 
 const float PI = 3.14159274f;
 
-GLuint noiseID;
+namespace {
+	// Philox 4x32-10, the same generator as GaussianNoise.comp
+	std::array<uint32_t, 4> philox(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key) {
+		for (int round = 0; round < 10; round++) {
+			uint64_t product0 = (uint64_t)0xD2511F53u * counter[0];
+			uint64_t product1 = (uint64_t)0xCD9E8D57u * counter[2];
+
+			counter = {
+				(uint32_t)(product1 >> 32) ^ counter[1] ^ key[0], (uint32_t)product1,
+				(uint32_t)(product0 >> 32) ^ counter[3] ^ key[1], (uint32_t)product0
+			};
+			key[0] += 0x9E3779B9u;
+			key[1] += 0xBB67AE85u;
+		}
 
-// Generates a size x size sized texture filled with Gaussian Distributed Random numbers
-void generateGaussianNoise(int size) {
-	float* data = (float*)calloc(size * size * 4, sizeof(float));
+		return counter;
+	}
+}
 
-	if (data != NULL) {
-		glGenTextures(1, &noiseID);
+glm::vec2 gaussianNoise(int x, int y, unsigned int seed) {
+	std::array<uint32_t, 4> random = philox({ (uint32_t)x, (uint32_t)y, 0, 0 }, { seed, 0 });
 
-		for (int i = 0; i < size; i++) {
-			for (int j = 0; j < size; j++) {
-				data[(size * i + j) * 4 + 0] = std::cos(2 * PI * distribution(generator)) * std::sqrt(-2 * std::log(distribution(generator)));
-				data[(size * i + j) * 4 + 1] = std::cos(2 * PI * distribution(generator)) * std::sqrt(-2 * std::log(distribution(generator)));
-				data[(size * i + j) * 4 + 2] = 0;
-				data[(size * i + j) * 4 + 3] = 0;
-			}
-		}
+	float u1 = (float)((random[0] >> 8) + 1) / 16777216.0f;
+	float u2 = (float)(random[1] >> 8) / 16777216.0f;
 
-		glBindTexture(GL_TEXTURE_2D, noiseID);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, size, size, 0, GL_RGBA, GL_FLOAT, data);
-	}
+	float radius = std::sqrt(-2 * std::log(u1));
+	float angle = 2 * PI * u2;
+	return glm::vec2(radius * std::cos(angle), radius * std::sin(angle));
 }
 
-Waves::Waves() {}
+// Generates a size x size sized texture filled with Gaussian Distributed Random numbers, directly on the GPU
+PooledTexture generateGaussianNoise(int size, unsigned int seed) {
+	PooledTexture noise(GL_TEXTURE_2D, GL_RG32F, size, size);
+	glTextureParameteri(noise.id(), GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(noise.id(), GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-Waves::Waves(int size, FastFourierTransform fft) : _size(size), _fft(fft) {
+	// Only needed once per ocean, so it isn't kept around
+	ComputeShader gaussianNoise("../shaders/GaussianNoise.comp");
 
-	_peakOmega = jonswapPeakFrequency(_gravity, _fetch, _windSpeed);
-	_alpha = jonswapAlpha(_gravity, _fetch, _windSpeed);
+	{
+		GpuProfiler::Scope scope("GaussianNoise");
 
-	_waveSpectra = ComputeShader("../shaders/WaveSpectra.comp");
-	_waveSpectraConjugate = ComputeShader("../shaders/WaveSpectraConjugate.comp");
-	_timeDependentSpectra = ComputeShader("../shaders/TimeDependentSpectra.comp");
-	_textureAssembler = ComputeShader("../shaders/TextureAssembler.comp");
-}
+		glUseProgram(gaussianNoise._programID);
+		glUniform1ui(glGetUniformLocation(gaussianNoise._programID, "seed"), seed);
+		glBindImageTexture(0, noise.id(), 0, false, 0, GL_WRITE_ONLY, GL_RG32F);
+		glDispatchCompute(size / 8, size / 8, 1);
+		glUseProgram(0);
+	}
 
-float Waves::jonswapPeakFrequency(float g, float fetch, float windspeed) {
-	return 22 * std::pow(windspeed * fetch / g / g, -0.33f);
+	return noise;
 }
 
-float Waves::jonswapAlpha(float g, float fetch, float windspeed) {
-	return 0.076f * std::pow(g * fetch / windspeed / windspeed, -0.22f);
-}
+Waves::Waves() {}
 
-std::vector<float> timings1;
-std::vector<float> timings2;
-std::vector<float> timings3;
+Waves::Waves(int size, int cascadeIndex, GLuint h0Texture, GLuint waveDataTexture) :
+	_cascadeIndex(cascadeIndex),
+	_h0Texture(h0Texture),
+	_waveDataTexture(waveDataTexture),
+	_size(size)
+{
+	_waveSpectra = ComputeShader("../shaders/WaveSpectra.comp");
+	_waveSpectraConjugate = ComputeShader("../shaders/WaveSpectraConjugate.comp");
+}
 
-void Waves::init(int scale, float edgeLow, float edgeHigh) {
-	_scale = scale;
-	calculateWaveSpectrum(scale, edgeLow, edgeHigh);
+void Waves::init(SpectrumParameters spectrum) {
+	_spectrum = spectrum;
+	calculateWaveSpectrum();
 	calculateConjugateSpectrum();
-
-	// Initialise all textures used in the compute shaders
-	glGenTextures(1, &_choppinessTexture);
-	glBindTexture(GL_TEXTURE_2D, _choppinessTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _size, _size, 0, GL_RGBA, GL_FLOAT, NULL);
-
-	glGenTextures(1, &_elevationTexture);
-	glBindTexture(GL_TEXTURE_2D, _elevationTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _size, _size, 0, GL_RGBA, GL_FLOAT, NULL);
-
-	glGenTextures(1, &_slopeParamsTexture);
-	glBindTexture(GL_TEXTURE_2D, _slopeParamsTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _size, _size, 0, GL_RGBA, GL_FLOAT, NULL);
-
-	glGenTextures(1, &_jacobianParamsTexture);
-	glBindTexture(GL_TEXTURE_2D, _jacobianParamsTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _size, _size, 0, GL_RGBA, GL_FLOAT, NULL);
-
-	glGenTextures(1, &_displacementTexture);
-	glBindTexture(GL_TEXTURE_2D, _displacementTexture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _size, _size, 0, GL_RGBA, GL_FLOAT, NULL);
-
-	glGenTextures(1, &_derivativesTexture);
-	glBindTexture(GL_TEXTURE_2D, _derivativesTexture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _size, _size, 0, GL_RGBA, GL_FLOAT, NULL);
-
-	glGenTextures(1, &_foamTexture);
-	glBindTexture(GL_TEXTURE_2D, _foamTexture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _size, _size, 0, GL_RGBA, GL_FLOAT, NULL);
-
-	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void Waves::calculateWaveSpectrum(int scale, float edgeLow, float edgeHigh) {
-	if (_h0kTexture == -1) {
-		glGenTextures(1, &_h0kTexture);
-		glBindTexture(GL_TEXTURE_2D, _h0kTexture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _size, _size, 0, GL_RGBA, GL_FLOAT, NULL);
-	}
+void Waves::calculateWaveSpectrum() {
+	// Only a complex value per texel
+	if (_h0kTexture.id() == 0)
+		_h0kTexture = PooledTexture(GL_TEXTURE_2D, GL_RG32F, _size, _size);
 	
-	if (_waveDataTexture == -1) {
-		glGenTextures(1, &_waveDataTexture);
-		glBindTexture(GL_TEXTURE_2D, _waveDataTexture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _size, _size, 0, GL_RGBA, GL_FLOAT, NULL);
-	}
+	GpuProfiler::Scope scope("WaveSpectra", _cascadeIndex);
 
 	glUseProgram(_waveSpectra._programID);
 
-	glUniform1i(0, scale);
+	glUniform1i(0, _spectrum.scale);
 	glUniform1i(1, _size);
-	glUniform1f(2, _gravity);
-	glUniform1f(3, _depth);
-	glUniform1f(4, _peakOmega);
-	glUniform1f(5, _alpha);
-	glUniform1f(6, _windSpeed);
-	glUniform1f(7, _windDirection);
-	glUniform1f(8, edgeLow);
-	glUniform1f(9, edgeHigh);
-
-	glBindImageTexture(0, _h0kTexture, 0, false, 0, GL_WRITE_ONLY, GL_RGBA32F);
-	glBindImageTexture(1, _waveDataTexture, 0, false, 0, GL_WRITE_ONLY, GL_RGBA32F);
-	glBindImageTexture(2, noiseID, 0, false, 0, GL_READ_ONLY, GL_RGBA32F);
+	glUniform1f(2, _spectrum.gravity);
+	glUniform1f(3, _spectrum.depth);
+	glUniform1f(4, _spectrum.peakOmega);
+	glUniform1f(5, _spectrum.alpha);
+	glUniform1f(6, _spectrum.windSpeed);
+	glUniform1f(7, _spectrum.windDirection);
+	glUniform1f(8, _spectrum.cutoffLowSquared());
+	glUniform1f(9, _spectrum.cutoffHighSquared());
+
+	glBindImageTexture(0, _h0kTexture.id(), 0, false, 0, GL_WRITE_ONLY, GL_RG32F);
+	glBindImageTexture(1, _waveDataTexture, 0, false, _cascadeIndex, GL_WRITE_ONLY, GL_RGBA32F);
+	glBindImageTexture(2, _noiseTexture, 0, false, 0, GL_READ_ONLY, GL_RG32F);
 
 	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 	glDispatchCompute(_size / 8, _size / 8, 1);
 }
 
 void Waves::calculateConjugateSpectrum() {
-	if (_h0Texture == -1) {
-		glGenTextures(1, &_h0Texture);
-		glBindTexture(GL_TEXTURE_2D, _h0Texture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _size, _size, 0, GL_RGBA, GL_FLOAT, NULL);
-	}
-	
+	GpuProfiler::Scope scope("WaveSpectraConjugate", _cascadeIndex);
+
 	glUseProgram(_waveSpectraConjugate._programID);
 
 	GLint sizeUniform = glGetUniformLocation(_waveSpectraConjugate._programID, "size");
 
 	glUniform1i(sizeUniform, _size);
 
-	glBindImageTexture(0, _h0kTexture, 0, false, 0, GL_READ_ONLY, GL_RGBA32F);
-	glBindImageTexture(1, _h0Texture, 0, false, 0, GL_WRITE_ONLY, GL_RGBA32F);
-
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-	glDispatchCompute(_size / 8, _size / 8, 1);
-}
-
-void Waves::calculateWavesAtTime(float time, float timeDelta) {
-	glUseProgram(_timeDependentSpectra._programID);
-
-	GLint timeUniform = glGetUniformLocation(_timeDependentSpectra._programID, "time");
-
-	glUniform1f(timeUniform, time);
-
-	glBindImageTexture(0, _choppinessTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(1, _elevationTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(2, _slopeParamsTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(3, _jacobianParamsTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(4, _h0Texture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(5, _waveDataTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-	glDispatchCompute(_size / 8, _size / 8, 1);
-
-	_fft.IFFT2D(_choppinessTexture, _h0kTexture);
-	_fft.IFFT2D(_elevationTexture, _h0kTexture);
-	_fft.IFFT2D(_slopeParamsTexture, _h0kTexture);
-	_fft.IFFT2D(_jacobianParamsTexture, _h0kTexture);
-
-	glUseProgram(_textureAssembler._programID);
-
-	GLint timeDeltaUniform = glGetUniformLocation(_textureAssembler._programID, "timeDelta");
-
-	glUniform1f(timeDeltaUniform, timeDelta);
-
-	glBindImageTexture(0, _displacementTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(1, _derivativesTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(2, _foamTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(3, _choppinessTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(4, _elevationTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(5, _slopeParamsTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(6, _jacobianParamsTexture, 0, false, 0, GL_READ_WRITE, GL_RGBA32F);
+	glBindImageTexture(0, _h0kTexture.id(), 0, false, 0, GL_READ_ONLY, GL_RG32F);
+	glBindImageTexture(1, _h0Texture, 0, false, _cascadeIndex, GL_WRITE_ONLY, GL_RGBA32F);
 
+	// h0 is a half spectrum
 	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-	glDispatchCompute(_size / 8, _size / 8, 1);
-	glUseProgram(0);
-}
-
-void Waves::recalculateInitials(WaveData waveData, int scale, float cutoffLow, float cutoffHigh) {
-	_peakOmega = jonswapPeakFrequency(waveData.gravity, waveData.fetch, waveData.windSpeed);
-	_alpha = jonswapAlpha(waveData.gravity, waveData.fetch, waveData.windSpeed);
-	_windDirection = waveData.angle;
-
-	calculateWaveSpectrum(scale, cutoffLow, cutoffHigh);
-	calculateConjugateSpectrum();
+	glDispatchCompute((FastFourierTransform::halfSpectrumWidth(_size) + 7) / 8, _size / 8, 1);
 }
-
-std::array<Waves, 3> initialise(WaveData waveData, int size) {
-	FastFourierTransform fft = FastFourierTransform(size);
-
-	generateGaussianNoise(size);
-
-	Waves waves1 = Waves(size, fft);
-	Waves waves2 = Waves(size, fft);
-	Waves waves3 = Waves(size, fft);
-	
-	float edge1 = 2 * PI / waveData.scale2 * 10.0f;
-	float edge2 = 2 * PI / waveData.scale3 * 10.0f;
-
-	waves1.init(waveData.scale1, 0.0001f, edge1);
-	waves2.init(waveData.scale2, edge1, edge2);
-	waves3.init(waveData.scale3, edge2, 9999.9f);
-
-	std::array<Waves, 3> waves = { waves1, waves2, waves3 };
-	return waves;
-}
\ No newline at end of file
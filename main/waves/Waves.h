@@ -1,58 +1,49 @@
 #pragma once
 
-#include <random>
 #include <array>
+#include <cstdint>
+#include <vector>
 
 #include "glm/glm.hpp"
 #include "glad/glad.h"
 
 #include "WaveData.h"
+#include "SpectrumParameters.h"
 #include "FastFourierTransform.h"
+#include "../utils/TexturePool.h"
 
+// One cascade (length scale) of the ocean. Computes the cascade's initial spectrum into its layer
+// of the h0 and wave data texture arrays owned by a WaveCascadeSet, which runs the per frame work.
 class Waves {
 public:
 	Waves();
-	Waves(int size, FastFourierTransform fft);
+	Waves(int size, int cascadeIndex, GLuint h0Texture, GLuint waveDataTexture);
 
-	float jonswapPeakFrequency(float g, float fetch, float windspeed);
-	float jonswapAlpha(float g, float fetch, float windspeed);
-	void init(int lengthScale, float cutoffLow, float cutoffHigh);
-	void calculateWaveSpectrum(int sScale, float cutoffLow, float cutoffHigh);
+	void init(SpectrumParameters spectrum);
+	void calculateWaveSpectrum();
 	void calculateConjugateSpectrum();
-	void calculateWavesAtTime(float time, float timeDelta);
-	void recalculateInitials(WaveData waveData, int scale, float cutoffLow, float cutoffHigh);
-
-	float _gravity = 9.81f;
-	float _fetch = 100000.0f;
-	int _scale = 250;
-	float _depth = 500.0f;
-	float _windSpeed = 7.29f;
-	float _windDirection = 29.81f;
-	float _peakOmega;
-	float _alpha;
 
-	ComputeShader _waveSpectra;
-	ComputeShader _waveSpectraConjugate;
-	ComputeShader _timeDependentSpectra;
-	ComputeShader _textureAssembler;
+	SpectrumParameters _spectrum;
 
-	GLuint _h0kTexture = -1;
-	GLuint _h0Texture = -1;
-	GLuint _waveDataTexture = -1;
+	// Which of the cascades this is, the layer written in the texture arrays
+	int _cascadeIndex = 0;
 
-	GLuint _choppinessTexture = -1;
-	GLuint _elevationTexture = -1;
-	GLuint _slopeParamsTexture = -1;
-	GLuint _jacobianParamsTexture = -1;
+	ComputeShader _waveSpectra;
+	ComputeShader _waveSpectraConjugate;
 
-	GLuint _displacementTexture = -1;
-	GLuint _derivativesTexture = -1;
-	GLuint _foamTexture = -1;
+	PooledTexture _h0kTexture;
 
-	FastFourierTransform _fft;
+	// Texture arrays owned by the WaveCascadeSet
+	GLuint _h0Texture = 0;
+	GLuint _waveDataTexture = 0;
+	GLuint _noiseTexture = 0; // Shared by every cascade, set by WaveCascadeSet::generateNoise
 
 private:
 	int _size;
 };
 
-std::array<Waves, 3> initialise(WaveData waveData, int size);
\ No newline at end of file
+// Noise texel (x, y) for a seed, both values standard normal. The same values as the texture made by generateGaussianNoise.
+glm::vec2 gaussianNoise(int x, int y, unsigned int seed);
+
+// A size x size GL_RG32F texture from the TexturePool
+PooledTexture generateGaussianNoise(int size, unsigned int seed);
\ No newline at end of file
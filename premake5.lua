@@ -16,6 +16,10 @@ workspace "WaterRendering"
 	filter "toolset:gcc"
 		buildoptions { "-Wall" }
 
+	-- Only the CpuOceanEngine's AVX2 FFT kernel, which it picks at runtime, so everything else runs on any x64 CPU
+	filter { "platforms:x64", "files:main/waves/CpuOceanEngineAvx2.cpp" }
+		vectorextensions "AVX2"
+
 	filter "toolset:msc-*"
 		warnings "extra"
 		buildoptions { "/utf-8" }
@@ -85,6 +89,8 @@ project "WaterRendering-main"
 project "WaterRendering-shaders"
 	local shaders = {
 		"shaders/**.vert",
+		"shaders/**.tesc",
+		"shaders/**.tese",
 		"shaders/**.frag",
 		"shaders/**.comp"
 	}
@@ -92,4 +98,33 @@ project "WaterRendering-shaders"
 	kind "Utility"
 	location "shaders"
 
-	files(shaders)
\ No newline at end of file
+	files(shaders)
+
+-- Headless benchmark of the wave pipeline (no window or monitor required)
+project "WaterRendering-bench"
+	local sources = {
+		"bench/**.cpp",
+		"bench/**.h*",
+		"main/utils/**.cpp",
+		"main/utils/**.h*",
+		"main/shaders/**.cpp",
+		"main/shaders/**.h*",
+		"main/waves/**.cpp",
+		"main/waves/**.h*",
+		"main/Globals.h"
+	}
+
+	kind "ConsoleApp"
+	location "bench"
+
+	files(sources)
+
+	links "x-stb"
+	links "x-glad"
+	links "x-glfw"
+	links "x-glm"
+
+	filter "system:linux"
+		links "EGL"
+
+	filter "*"
@@ -1,4 +1,4 @@
-#version 460
+#version 450
 
 #define PI 3.14159265
 
@@ -13,13 +13,9 @@ layout(location = 11) uniform float ao; // Ambient occlusion
 layout(location = 12) uniform float foamStrength;
 layout(location = 13) uniform int wireframe;
 
-// Samplers
-layout(binding = 3) uniform sampler2D derivatives1;
-layout(binding = 4) uniform sampler2D derivatives2;
-layout(binding = 5) uniform sampler2D derivatives3;
-layout(binding = 6) uniform sampler2D turbulence1;
-layout(binding = 7) uniform sampler2D turbulence2;
-layout(binding = 8) uniform sampler2D turbulence3;
+// Samplers, one layer per cascade
+layout(binding = 3) uniform sampler2DArray derivativesArray;
+layout(binding = 6) uniform sampler2DArray turbulence;
 
 // Passthroughs
 in vec3 outPos;
@@ -117,17 +113,17 @@ vec3 LightingEquation(vec3 mAlbedo, float jacobian, vec3 normal, vec3 viewDir, v
 void main() {
 	vec2 coords = outPos.xz;
 
-	vec4 derivatives = texture(derivatives1, coords / outScale1) * outLods.x;
-	derivatives		+= texture(derivatives2, coords / outScale2) * outLods.y;
-	derivatives		+= texture(derivatives3, coords / outScale3) * outLods.z;
+	vec4 derivatives = texture(derivativesArray, vec3(coords / outScale1, 0)) * outLods.x;
+	derivatives		+= texture(derivativesArray, vec3(coords / outScale2, 1)) * outLods.y;
+	derivatives		+= texture(derivativesArray, vec3(coords / outScale3, 2)) * outLods.z;
 	
 	vec2 slopeVector = vec2(derivatives.x / (1 + derivatives.z), derivatives.y / (1 + derivatives.w));
 	vec3 normal = normalize(vec3(-slopeVector.x, 1, -slopeVector.y));
 	vec3 viewDir = normalize(outViewPos - outPos);
 
-	float jacobian = texture(turbulence1, coords / outScale1).x;
-	jacobian	  += texture(turbulence2, coords / outScale2).x;
-	jacobian	  += texture(turbulence3, coords / outScale3).x;
+	float jacobian = texture(turbulence, vec3(coords / outScale1, 0)).x;
+	jacobian	  += texture(turbulence, vec3(coords / outScale2, 1)).x;
+	jacobian	  += texture(turbulence, vec3(coords / outScale3, 2)).x;
 	jacobian = min(1, max(0, foamStrength - jacobian));
 	
 	float fresnel = dot(normal, viewDir);
@@ -1,7 +1,15 @@
-#version 460
+#version 450
 
-// VAO attributes
+// OceanMesh's MeshMode
+#define MESH_INDEXED 0
+#define MESH_VERTEX_PULLING 1
+#define MESH_CLIPMAP 2
+#define MESH_TESSELLATION 3
+#define MESH_TILED 4
+
+// VAO attributes, iPosition for MESH_INDEXED and iTile (a ClipmapTile: origin xz, spacing, level) for MESH_CLIPMAP and MESH_TILED
 layout(location = 0) in vec3 iPosition;
+layout(location = 1) in vec4 iTile;
 
 // Uniforms
 layout(location = 0) uniform mat4 mvpMatrix;
@@ -10,11 +18,12 @@ layout(location = 2) uniform int scale1;
 layout(location = 3) uniform int scale2;
 layout(location = 4) uniform int scale3;
 layout(location = 5) uniform vec3 camPos;
+layout(location = 14) uniform int meshMode;
+layout(location = 15) uniform int tileSize; // Quads across a clipmap tile, units across a tiled instance or a tessellation patch
+layout(location = 16) uniform vec2 morphRanges[8]; // Distances where each clipmap or tiled level starts and finishes morphing
 
-// Samplers
-layout(binding = 0) uniform sampler2D displacements1;
-layout(binding = 1) uniform sampler2D displacements2;
-layout(binding = 2) uniform sampler2D displacements3;
+// Samplers, one layer per cascade
+layout(binding = 0) uniform sampler2DArray displacements;
 
 // Fragment passthroughs
 out vec3 outPos;
@@ -25,28 +34,77 @@ out int outScale3;
 out vec3 outViewPos;
 out vec3 outLods;
 
+// Clipmap tiles are indexed grids of (tileSize + 1)^2 vertices placed by their instance. Towards the end of its level's
+// range every odd vertex slides onto its even neighbour, so the tile has become the next level's grid where the two meet.
+// A tiled instance keeps its extent and has tileSize >> level quads across, each level's grid following the last's in the index buffer.
+vec3 ClipmapPosition() {
+	int quads = meshMode == MESH_TILED ? tileSize >> int(iTile.w) : tileSize;
+	ivec2 local = ivec2(gl_VertexID % (quads + 1), gl_VertexID / (quads + 1));
+	vec2 world = iTile.xy + vec2(local) * iTile.z;
+
+	vec2 range = morphRanges[int(iTile.w)];
+	float morph = clamp((length(camPos - vec3(world.x, 0, world.y)) - range.x) / (range.y - range.x), 0, 1);
+	world -= vec2(local & 1) * iTile.z * morph;
+
+	return vec3(world.x, 0, world.y);
+}
+
+// Patch p of a tessellated draw is the square of tileSize units at column p % patches and row p / patches of a size x size
+// grid, its four vertices going round the square. PBR.tesc subdivides it and PBR.tese displaces the result.
+vec3 PatchCorner() {
+	int patches = max(size / tileSize, 1);
+	int patchIndex = gl_VertexID >> 2;
+	int corner = gl_VertexID & 3;
+
+	ivec2 cell = ivec2(patchIndex % patches, patchIndex / patches) + ivec2(corner == 1 || corner == 2, corner >= 2);
+	return vec3(cell.x * tileSize, 0, cell.y * tileSize);
+}
+
+// Instance i of a vertex pulling draw is a triangle strip over the quads between grid columns i and i + 1,
+// alternating between the two columns as it steps along z. Starting on column i + 1 gives the indexed mesh's
+// triangles, diagonals and winding.
+vec3 GridPosition() {
+	if (meshMode == MESH_INDEXED)
+		return iPosition;
+	if (meshMode == MESH_CLIPMAP || meshMode == MESH_TILED)
+		return ClipmapPosition();
+	if (meshMode == MESH_TESSELLATION)
+		return PatchCorner();
+
+	int x = gl_InstanceID + 1 - (gl_VertexID & 1);
+	int z = gl_VertexID >> 1;
+	return vec3(x, 0, z);
+}
+
 void main() {
-	outPos = iPosition;
+	vec3 position = GridPosition();
+
+	if (meshMode == MESH_TESSELLATION) {
+		gl_Position = vec4(position, 1.0);
+		return;
+	}
+
+	outPos = position;
 	outSize = size;
 	outScale1 = scale1;
 	outScale2 = scale2;
 	outScale3 = scale3;
 	outViewPos = camPos;
 
-	float viewDist = length(camPos - iPosition);
+	float viewDist = length(camPos - position);
 	float lod1 = min(10 * scale1 / viewDist, 1);
 	float lod2 = min(10 * scale2 / viewDist, 1);
 	float lod3 = min(10 * scale3 / viewDist, 1);
 	outLods = vec3(lod1, lod2, lod3);
 
-	vec2 coords = iPosition.xz;
+	vec2 coords = position.xz;
 
-	vec3 displacements = vec3(0);
-	displacements += texture(displacements1, coords / scale1).xyz;
-	displacements += texture(displacements2, coords / scale2).xyz;
-	displacements += texture(displacements3, coords / scale3).xyz;
+	vec3 displacement = vec3(0);
+	displacement += texture(displacements, vec3(coords / scale1, 0)).xyz;
+	displacement += texture(displacements, vec3(coords / scale2, 1)).xyz;
+	displacement += texture(displacements, vec3(coords / scale3, 2)).xyz;
 
-	vec4 finalPos = mvpMatrix * vec4(iPosition + displacements, 1.0);
+	vec4 finalPos = mvpMatrix * vec4(position + displacement, 1.0);
 
 	gl_Position = finalPos;
 }
\ No newline at end of file
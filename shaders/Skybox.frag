@@ -1,4 +1,4 @@
-#version 460
+#version 450
 
 // Samplers
 layout(binding = 0) uniform samplerCube skybox;